@@ -0,0 +1,168 @@
+/*
+ * fuente.c
+ *
+ * Fuente de trazos y recorrido de texto (ver fuente.h).
+ * Formato de cada glifo en FUENTE:
+ *   [codigo ASCII] [movimientos...] [FF]
+ * Cada movimiento es un byte con dx en el nibble alto y dy en el bajo
+ * (con signo, -7..7). FS delante de un movimiento lo hace con el lapiz
+ * arriba. Todos los glifos empiezan en (0, 0) con el lapiz arriba; la
+ * tabla termina con un codigo 0. Las minusculas se dibujan como
+ * mayusculas y lo que no esta en la tabla como '?'.
+ */
+
+#include <avr/pgmspace.h>
+#include "fuente.h"
+
+
+#define FM(dx, dy)  (uint8_t)((((dx) & 0x0F) << 4) | ((dy) & 0x0F))
+#define FS          0x80        // FM(-8, 0): no se usa como movimiento
+#define FF          0x00        // FM(0, 0): fin del glifo
+
+const uint8_t FUENTE[] PROGMEM = {
+	'!', FS, FM(2, 6), FM(0, -4), FS, FM(0, -1), FM(0, -1), FF,
+	'\'', FS, FM(2, 6), FM(0, -2), FF,
+	'(', FS, FM(3, 6), FM(-1, -1), FM(0, -4), FM(1, -1), FF,
+	')', FS, FM(1, 6), FM(1, -1), FM(0, -4), FM(-1, -1), FF,
+	'+', FS, FM(2, 1), FM(0, 4), FS, FM(-2, -2), FM(4, 0), FF,
+	',', FS, FM(2, 1), FM(-1, -2), FF,
+	'-', FS, FM(1, 3), FM(2, 0), FF,
+	'.', FS, FM(2, 0), FM(0, 1), FF,
+	'/', FM(4, 6), FF,
+	'0', FS, FM(1, 0), FM(-1, 1), FM(0, 4), FM(1, 1), FM(2, 0), FM(1, -1), FM(0, -4), FM(-1, -1),
+		FM(-2, 0), FS, FM(-1, 1), FM(4, 4), FF,
+	'1', FS, FM(1, 5), FM(1, 1), FM(0, -6), FS, FM(-1, 0), FM(2, 0), FF,
+	'2', FS, FM(0, 5), FM(1, 1), FM(2, 0), FM(1, -1), FM(0, -1), FM(-4, -4), FM(4, 0), FF,
+	'3', FS, FM(0, 5), FM(1, 1), FM(2, 0), FM(1, -1), FM(0, -1), FM(-1, -1), FM(1, -1), FM(0, -1),
+		FM(-1, -1), FM(-2, 0), FM(-1, 1), FS, FM(1, 2), FM(2, 0), FF,
+	'4', FS, FM(3, 0), FM(0, 6), FM(-3, -4), FM(4, 0), FF,
+	'5', FS, FM(4, 6), FM(-4, 0), FM(0, -3), FM(3, 0), FM(1, -1), FM(0, -1), FM(-1, -1), FM(-2, 0),
+		FM(-1, 1), FF,
+	'6', FS, FM(4, 5), FM(-1, 1), FM(-2, 0), FM(-1, -1), FM(0, -4), FM(1, -1), FM(2, 0), FM(1, 1),
+		FM(0, 1), FM(-1, 1), FM(-3, 0), FF,
+	'7', FS, FM(0, 6), FM(4, 0), FM(-3, -6), FF,
+	'8', FS, FM(1, 3), FM(-1, 1), FM(0, 1), FM(1, 1), FM(2, 0), FM(1, -1), FM(0, -1), FM(-1, -1),
+		FM(-2, 0), FM(-1, -1), FM(0, -1), FM(1, -1), FM(2, 0), FM(1, 1), FM(0, 1), FM(-1, 1), FF,
+	'9', FS, FM(0, 1), FM(1, -1), FM(2, 0), FM(1, 1), FM(0, 4), FM(-1, 1), FM(-2, 0), FM(-1, -1),
+		FM(0, -1), FM(1, -1), FM(3, 0), FF,
+	':', FS, FM(2, 4), FM(0, 1), FS, FM(0, -4), FM(0, 1), FF,
+	'=', FS, FM(0, 2), FM(4, 0), FS, FM(-4, 2), FM(4, 0), FF,
+	'?', FS, FM(0, 5), FM(1, 1), FM(2, 0), FM(1, -1), FM(0, -1), FM(-2, -1), FM(0, -1), FS,
+		FM(0, -1), FM(0, -1), FF,
+	'A', FM(0, 4), FM(2, 2), FM(2, -2), FM(0, -4), FS, FM(-4, 3), FM(4, 0), FF,
+	'B', FM(0, 6), FM(3, 0), FM(1, -1), FM(0, -1), FM(-1, -1), FM(-3, 0), FS, FM(3, 0), FM(1, -1),
+		FM(0, -1), FM(-1, -1), FM(-3, 0), FF,
+	'C', FS, FM(4, 5), FM(-1, 1), FM(-2, 0), FM(-1, -1), FM(0, -4), FM(1, -1), FM(2, 0), FM(1, 1),
+		FF,
+	'D', FM(0, 6), FM(2, 0), FM(2, -2), FM(0, -2), FM(-2, -2), FM(-2, 0), FF,
+	'E', FS, FM(4, 6), FM(-4, 0), FM(0, -6), FM(4, 0), FS, FM(-4, 3), FM(3, 0), FF,
+	'F', FS, FM(4, 6), FM(-4, 0), FM(0, -6), FS, FM(0, 3), FM(3, 0), FF,
+	'G', FS, FM(4, 5), FM(-1, 1), FM(-2, 0), FM(-1, -1), FM(0, -4), FM(1, -1), FM(2, 0), FM(1, 1),
+		FM(0, 2), FM(-2, 0), FF,
+	'H', FM(0, 6), FS, FM(4, -6), FM(0, 6), FS, FM(-4, -3), FM(4, 0), FF,
+	'I', FS, FM(1, 6), FM(2, 0), FS, FM(-1, 0), FM(0, -6), FS, FM(-1, 0), FM(2, 0),
+		FF,
+	'J', FS, FM(4, 6), FM(0, -5), FM(-1, -1), FM(-2, 0), FM(-1, 1), FF,
+	'K', FM(0, 6), FS, FM(4, 0), FM(-4, -4), FS, FM(1, 1), FM(3, -3), FF,
+	'L', FS, FM(0, 6), FM(0, -6), FM(4, 0), FF,
+	'M', FM(0, 6), FM(2, -3), FM(2, 3), FM(0, -6), FF,
+	'N', FM(0, 6), FM(4, -6), FM(0, 6), FF,
+	'O', FS, FM(1, 0), FM(-1, 1), FM(0, 4), FM(1, 1), FM(2, 0), FM(1, -1), FM(0, -4), FM(-1, -1),
+		FM(-2, 0), FF,
+	'P', FM(0, 6), FM(3, 0), FM(1, -1), FM(0, -1), FM(-1, -1), FM(-3, 0), FF,
+	'Q', FS, FM(1, 0), FM(-1, 1), FM(0, 4), FM(1, 1), FM(2, 0), FM(1, -1), FM(0, -4), FM(-1, -1),
+		FM(-2, 0), FS, FM(1, 2), FM(2, -2), FF,
+	'R', FM(0, 6), FM(3, 0), FM(1, -1), FM(0, -1), FM(-1, -1), FM(-3, 0), FS, FM(2, 0), FM(2, -3),
+		FF,
+	'S', FS, FM(4, 5), FM(-1, 1), FM(-2, 0), FM(-1, -1), FM(0, -1), FM(1, -1), FM(2, 0), FM(1, -1),
+		FM(0, -1), FM(-1, -1), FM(-2, 0), FM(-1, 1), FF,
+	'T', FS, FM(0, 6), FM(4, 0), FS, FM(-2, 0), FM(0, -6), FF,
+	'U', FS, FM(0, 6), FM(0, -5), FM(1, -1), FM(2, 0), FM(1, 1), FM(0, 5), FF,
+	'V', FS, FM(0, 6), FM(2, -6), FM(2, 6), FF,
+	'W', FS, FM(0, 6), FM(1, -6), FM(1, 4), FM(1, -4), FM(1, 6), FF,
+	'X', FM(4, 6), FS, FM(-4, 0), FM(4, -6), FF,
+	'Y', FS, FM(0, 6), FM(2, -3), FM(2, 3), FS, FM(-2, -3), FM(0, -3), FF,
+	'Z', FS, FM(0, 6), FM(4, 0), FM(-4, -6), FM(4, 0), FF,
+	0
+};
+
+// Busca el glifo de c. Devuelve el primer movimiento, o 0 si no esta
+static const uint8_t *fuente_buscar(char c) {
+	const uint8_t *g = FUENTE;
+	uint8_t codigo;
+
+	if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+
+	while ((codigo = pgm_read_byte(g++)) != 0) {
+		if (codigo == (uint8_t)c) return g;
+		while (pgm_read_byte(g++) != FF) ;
+	}
+	return 0;
+}
+
+void texto_init(Texto *t, const char *s) {
+	t->s = s;
+	t->g = 0;
+	t->gx = t->gy = 0;
+	t->abajo = 0;
+	t->saltar = 0;
+	linea_init(&t->l, 0, 0);
+}
+
+// Cambia el lapiz si hace falta. Devuelve 1 si genero el paso del solenoide
+static uint8_t texto_pluma(Texto *t, uint8_t abajo, Paso *p) {
+	if (t->abajo == abajo) return 0;
+	t->abajo = abajo;
+	p->cmd = abajo ? SOLENOID_DOWN : SOLENOID_UP;
+	p->ms = FUENTE_PLUMA_MS;
+	return 1;
+}
+
+// Prepara la recta (dx, dy) en unidades; el paso del lapiz, si hay, sale antes
+static uint8_t texto_mover(Texto *t, int8_t dx, int8_t dy, uint8_t abajo, Paso *p) {
+	t->gx += dx;
+	t->gy += dy;
+	linea_init(&t->l, (int16_t)dx * FUENTE_UNIDAD, (int16_t)dy * FUENTE_UNIDAD);
+	return texto_pluma(t, abajo, p);
+}
+
+uint8_t texto_paso(Texto *t, Paso *p) {
+	for (;;) {
+		if (linea_paso(&t->l, p)) return 1;
+
+		if (!t->g) {
+			char c = *t->s;
+			if (c == '\0') return texto_pluma(t, 0, p);
+			t->s++;
+
+			// El lapiz ya esta arriba: el primer movimiento dibuja salvo
+			// que el glifo empiece con FS
+			t->gx = t->gy = 0;
+			t->saltar = 0;
+			t->g = fuente_buscar(c);
+			if (!t->g && c != ' ') t->g = fuente_buscar('?');
+			if (!t->g) {                        // espacio
+				if (texto_mover(t, FUENTE_AVANCE, 0, 0, p)) return 1;
+				continue;
+			}
+		}
+
+		uint8_t b = pgm_read_byte(t->g++);
+		if (b == FF) {
+			// Al origen del caracter siguiente, con el lapiz arriba
+			t->g = 0;
+			if (texto_mover(t, FUENTE_AVANCE - t->gx, -t->gy, 0, p)) return 1;
+			continue;
+		}
+		if (b == FS) {
+			t->saltar = 1;
+			continue;
+		}
+
+		int8_t dx = (int8_t)b >> 4;
+		int8_t dy = (int8_t)(b << 4) >> 4;
+		uint8_t abajo = !t->saltar;
+		t->saltar = 0;
+		if (texto_mover(t, dx, dy, abajo, p)) return 1;
+	}
+}
@@ -0,0 +1,35 @@
+/*
+ * fuente.h
+ *
+ * Texto con una fuente de trazos (estilo Hershey) guardada en flash.
+ * Cada glifo es una lista de movimientos relativos sobre una grilla de
+ * 4 x 6 unidades (base en y = 0); el texto se recorre de a un caracter y
+ * cada movimiento sale como una recta del motor de lineas, asi que una
+ * etiqueta no ocupa mas flash que la propia cadena.
+ */
+
+
+#ifndef FUENTE_H_
+#define FUENTE_H_
+
+#include <stdint.h>
+#include "motion.h"
+#include "trazo.h"
+
+#define FUENTE_UNIDAD    500       // ms de motor por unidad de la grilla
+#define FUENTE_AVANCE    6         // unidades de un caracter al siguiente
+#define FUENTE_PLUMA_MS  100       // espera al mover el solenoide
+
+typedef struct {
+	const char    *s;       // proximo caracter (SRAM)
+	const uint8_t *g;       // proximo byte del glifo en curso (0 = ninguno)
+	int8_t  gx, gy;         // posicion dentro del glifo, en unidades
+	uint8_t abajo;          // lapiz abajo
+	uint8_t saltar;         // el proximo movimiento es con el lapiz arriba
+	Linea   l;
+} Texto;
+
+void texto_init(Texto *t, const char *s);
+uint8_t texto_paso(Texto *t, Paso *p);   // 0 cuando termino el texto
+
+#endif /* FUENTE_H_ */
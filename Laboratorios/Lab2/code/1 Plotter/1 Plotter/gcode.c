@@ -0,0 +1,376 @@
+/*
+ * gcode.c
+ *
+ * Interprete de G-code (ver gcode.h).
+ * Todo corre en el lazo principal: gcode_servicio() lee caracteres de la
+ * UART mientras haya lugar en la cola de comandos y va cargando pasos en
+ * la cola del Timer1. Si la cola de comandos esta llena se deja de leer,
+ * el buffer de recepcion se llena y el receptor le pide al host que pare.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "gcode.h"
+#include "motion.h"
+#include "trazo.h"
+
+
+// Definidas en main.c
+char Chardos(void);
+void serialWrite(const char *c);
+void serialWrite_P(const char *s);
+void rx_vaciar(void);
+extern volatile uint8_t rx_cancelar;
+
+
+static uint8_t gc_modo = 0;               // 1 mientras se interpreta G-code
+static uint8_t gc_terminando = 0;         // se leyo M2: no se lee mas, se espera a que termine
+
+// Lectura de la linea
+static char    gc_linea[GC_LINEA_MAX + 1];
+static uint8_t gc_largo = 0;
+static uint8_t gc_comentario = 0;         // 1 = ';' hasta fin de linea, 2 = '(' hasta ')'
+static uint8_t gc_larga = 0;              // la linea no entro en el buffer
+static char    gc_anterior = 0;           // para tomar "\r\n" como un solo fin de linea
+
+// Estado modal del interprete
+static int32_t gc_x = 0, gc_y = 0;        // posicion al final del ultimo comando
+static uint8_t gc_relativo = 0;           // G91
+static uint8_t gc_mov = 0;                // ultimo G0..G3
+
+// Cola de comandos interpretados
+static GcComando gc_cola[GC_COLA];
+static uint8_t gc_entra = 0, gc_sale = 0, gc_cant = 0;
+
+// Ejecucion
+static Linea   gc_recta;
+static Arco    gc_arco;
+static uint8_t gc_arco_activo = 0;
+static int16_t gc_arco_dx, gc_arco_dy;    // destino del arco, para corregir al final
+static uint8_t gc_pluma = GC_PLUMA_IGUAL; // IGUAL = no se sabe todavia
+
+
+// msg en flash
+static void gc_error(const char *msg) {
+	serialWrite_P(PSTR("error: "));
+	serialWrite_P(msg);
+	serialWrite_P(PSTR("\n"));
+}
+
+// Lee un numero con signo. Los decimales se redondean al entero.
+static uint8_t gc_numero(const char **s, int32_t *v) {
+	const char *p = *s;
+	uint8_t neg = 0, hay = 0;
+	int32_t n = 0;
+
+	if (*p == '-' || *p == '+') neg = (*p++ == '-');
+
+	while (*p >= '0' && *p <= '9') {
+		if (n < 100000L) n = n * 10 + (*p - '0');
+		p++;
+		hay = 1;
+	}
+	if (*p == '.') {
+		p++;
+		if (*p >= '5' && *p <= '9') n++;
+		while (*p >= '0' && *p <= '9') {
+			p++;
+			hay = 1;
+		}
+	}
+
+	*s = p;
+	*v = neg ? -n : n;
+	return hay;
+}
+
+static uint8_t gc_rango(int32_t v) {
+	return v >= -32767 && v <= 32767;
+}
+
+// Traduce una linea ya sin espacios ni comentarios a un comando.
+// Devuelve 0 si hubo error (ya informado).
+static uint8_t gc_interpretar(const char *l, GcComando *c) {
+	int32_t v, vx = 0, vy = 0, vi = 0, vj = 0, vp = 0, vz = 0;
+	uint8_t hay_x = 0, hay_y = 0, hay_z = 0, hay_p = 0;
+	int16_t g = -1, m = -1;
+
+	while (*l) {
+		char letra = *l++;
+		if (letra >= 'a' && letra <= 'z') letra -= 'a' - 'A';
+
+		if (!gc_numero(&l, &v)) {
+			gc_error(PSTR("numero"));
+			return 0;
+		}
+
+		switch (letra) {
+			case 'G': g = (int16_t)v; break;
+			case 'M': m = (int16_t)v; break;
+			case 'X': vx = v; hay_x = 1; break;
+			case 'Y': vy = v; hay_y = 1; break;
+			case 'I': vi = v; break;
+			case 'J': vj = v; break;
+			case 'P': vp = v; hay_p = 1; break;
+			case 'Z': vz = v; hay_z = 1; break;
+			case 'F': case 'N': case 'S': break;    // sin efecto en este plotter
+			default:
+			gc_error(PSTR("letra"));
+			return 0;
+		}
+	}
+
+	c->tipo = GC_NADA;
+	c->pluma = GC_PLUMA_IGUAL;
+
+	switch (m) {
+		case -1: break;
+		case 3:  c->pluma = GC_PLUMA_ABAJO; break;
+		case 5:  c->pluma = GC_PLUMA_ARRIBA; break;
+		case 2:
+		case 30:
+		c->tipo = GC_FIN;
+		c->pluma = GC_PLUMA_ARRIBA;
+		return 1;
+		default:
+		gc_error(PSTR("codigo M"));
+		return 0;
+	}
+
+	switch (g) {
+		case -1: break;
+		case 0: case 1: case 2: case 3:
+		gc_mov = (uint8_t)g;
+		break;
+		case 4:
+		if (!hay_p || vp < 0 || vp > 65535L) {
+			gc_error(PSTR("pausa"));
+			return 0;
+		}
+		c->tipo = GC_PAUSA;
+		c->x = (int16_t)(uint16_t)vp;
+		return 1;
+		case 20: case 21: return 1;               // unidades: siempre ms
+		case 90: gc_relativo = 0; return 1;
+		case 91: gc_relativo = 1; return 1;
+		case 92:
+		if (hay_x) gc_x = vx;
+		if (hay_y) gc_y = vy;
+		return 1;
+		default:
+		gc_error(PSTR("codigo G"));
+		return 0;
+	}
+
+	if (hay_z) c->pluma = (vz <= 0) ? GC_PLUMA_ABAJO : GC_PLUMA_ARRIBA;
+
+	// Sin coordenadas: solo lapiz (M3, M5, Z) o nada
+	if (!hay_x && !hay_y && g < 0) return 1;
+
+	int32_t tx = hay_x ? (gc_relativo ? gc_x + vx : vx) : gc_x;
+	int32_t ty = hay_y ? (gc_relativo ? gc_y + vy : vy) : gc_y;
+	int32_t dx = tx - gc_x;
+	int32_t dy = ty - gc_y;
+
+	if (!gc_rango(dx) || !gc_rango(dy)) {
+		gc_error(PSTR("rango"));
+		return 0;
+	}
+
+	if (gc_mov >= 2) {
+		// Punto final respecto del centro
+		int32_t ex = dx - vi;
+		int32_t ey = dy - vj;
+		if (!gc_rango(vi) || !gc_rango(vj) || !gc_rango(ex) || !gc_rango(ey)) {
+			gc_error(PSTR("rango"));
+			return 0;
+		}
+		c->tipo = (gc_mov == 2) ? GC_ARCO_H : GC_ARCO_A;
+		c->i = (int16_t)vi;
+		c->j = (int16_t)vj;
+	}
+	else {
+		c->tipo = GC_RECTA;
+	}
+
+	if (!hay_z && c->pluma == GC_PLUMA_IGUAL) {
+		c->pluma = (gc_mov == 0) ? GC_PLUMA_ARRIBA : GC_PLUMA_ABAJO;
+	}
+
+	c->x = (int16_t)dx;
+	c->y = (int16_t)dy;
+	gc_x = tx;
+	gc_y = ty;
+	return 1;
+}
+
+// Termina la linea leida: la interpreta, la encola y contesta al host
+static void gc_fin_linea(void) {
+	GcComando *c = &gc_cola[gc_entra];
+
+	gc_linea[gc_largo] = '\0';
+
+	if (gc_larga) {
+		gc_error(PSTR("linea larga"));
+	}
+	else if (gc_largo == 0) {
+		serialWrite_P(PSTR("ok\n"));
+	}
+	else if (gc_interpretar(gc_linea, c)) {
+		if (c->tipo != GC_NADA || c->pluma != GC_PLUMA_IGUAL) {
+			gc_entra = (gc_entra + 1) % GC_COLA;
+			gc_cant++;
+		}
+		if (c->tipo == GC_FIN) gc_terminando = 1;
+		serialWrite_P(PSTR("ok\n"));
+	}
+
+	gc_largo = 0;
+	gc_comentario = 0;
+	gc_larga = 0;
+}
+
+// Lee caracteres mientras haya lugar para otro comando
+static void gc_leer(void) {
+	while (gc_cant < GC_COLA && !gc_terminando) {
+		char ch = Chardos();
+		if (ch == '\0') return;
+
+		char anterior = gc_anterior;
+		gc_anterior = ch;
+
+		if (ch == '\n' || ch == '\r') {
+			if (!(ch == '\n' && anterior == '\r')) gc_fin_linea();
+			continue;
+		}
+		if (gc_comentario == 1) continue;
+		if (gc_comentario == 2) {
+			if (ch == ')') gc_comentario = 0;
+			continue;
+		}
+		if (ch == ';') {
+			gc_comentario = 1;
+			continue;
+		}
+		if (ch == '(') {
+			gc_comentario = 2;
+			continue;
+		}
+		if (ch == ' ' || ch == '\t') continue;
+
+		if (gc_largo < GC_LINEA_MAX) gc_linea[gc_largo++] = ch;
+		else gc_larga = 1;
+	}
+}
+
+// Proximo paso a encolar. Devuelve 0 si por ahora no hay nada
+static uint8_t gc_paso(Paso *p) {
+	for (;;) {
+		if (linea_paso(&gc_recta, p)) return 1;
+		if (arco_paso(&gc_arco, p)) return 1;
+
+		// El arco corta al cruzar la direccion final: se completa con una recta
+		if (gc_arco_activo) {
+			int16_t rx, ry;
+			arco_recorrido(&gc_arco, &rx, &ry);
+			linea_init(&gc_recta, gc_arco_dx - rx, gc_arco_dy - ry);
+			gc_arco_activo = 0;
+			continue;
+		}
+
+		if (gc_cant == 0) return 0;
+		GcComando *c = &gc_cola[gc_sale];
+
+		// Primero el lapiz; el comando queda en la cola sin el cambio
+		if (c->pluma != GC_PLUMA_IGUAL) {
+			uint8_t pl = c->pluma;
+			c->pluma = GC_PLUMA_IGUAL;
+			if (pl != gc_pluma) {
+				gc_pluma = pl;
+				p->cmd = (pl == GC_PLUMA_ABAJO) ? SOLENOID_DOWN : SOLENOID_UP;
+				p->ms = GC_PLUMA_MS;
+				return 1;
+			}
+		}
+
+		gc_sale = (gc_sale + 1) % GC_COLA;
+		gc_cant--;
+
+		switch (c->tipo) {
+			case GC_RECTA:
+			linea_init(&gc_recta, c->x, c->y);
+			break;
+
+			case GC_ARCO_H:
+			case GC_ARCO_A:
+			arco_init(&gc_arco, -c->i, -c->j, c->x - c->i, c->y - c->j, c->tipo == GC_ARCO_H);
+			gc_arco_dx = c->x;
+			gc_arco_dy = c->y;
+			gc_arco_activo = 1;
+			break;
+
+			case GC_PAUSA:
+			if (c->x == 0) break;
+			p->cmd = STOP;
+			p->ms = (uint16_t)c->x;
+			return 1;
+
+			case GC_FIN:               // solo sube el lapiz
+			break;
+		}
+	}
+}
+
+static void gc_reiniciar(void) {
+	gc_largo = 0;
+	gc_comentario = 0;
+	gc_larga = 0;
+	gc_anterior = 0;
+	gc_entra = gc_sale = gc_cant = 0;
+	gc_terminando = 0;
+	gc_arco_activo = 0;
+	linea_init(&gc_recta, 0, 0);
+	arco_init(&gc_arco, 0, 0, 0, 0, 0);
+}
+
+void gcode_iniciar(void) {
+	gc_reiniciar();
+	gc_x = gc_y = 0;
+	gc_relativo = 0;
+	gc_mov = 0;
+	gc_pluma = GC_PLUMA_IGUAL;
+	rx_cancelar = 0;
+	gc_modo = 1;
+	serialWrite_P(PSTR("G-code listo (M2 termina, Ctrl-X cancela)\n"));
+}
+
+uint8_t gcode_activo(void) {
+	return gc_modo;
+}
+
+void gcode_servicio(void) {
+	Paso p = {0, 0, 0, 0};
+
+	if (!gc_modo) return;
+
+	if (rx_cancelar) {
+		rx_cancelar = 0;
+		motion_abort();
+		rx_vaciar();
+		gc_reiniciar();
+		gc_modo = 0;
+		serialWrite_P(PSTR("Cancelado\n"));
+		return;
+	}
+
+	gc_leer();
+
+	if (motion_libre() && gc_paso(&p)) {
+		motion_push_paso(&p);
+	}
+	else if (gc_terminando && gc_cant == 0 && !motion_ocupado()) {
+		gc_modo = 0;
+		serialWrite_P(PSTR("Fin G-code\n"));
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * gcode.h
+ *
+ * Interprete de G-code por UART.
+ * Las lineas llegan por el buffer circular de recepcion, se traducen a
+ * comandos (dos lugares: mientras uno se dibuja el otro ya esta listo) y
+ * se ejecutan con el motor de lineas y arcos de trazo.c.
+ *
+ * Unidades: ms de motor por eje, igual que las figuras vectoriales.
+ *   G0 X Y          mover con el lapiz arriba
+ *   G1 X Y          linea con el lapiz abajo
+ *   G2/G3 X Y I J   arco horario / antihorario, centro en (I, J) relativo
+ *   G4 P            pausa de P ms
+ *   G90 / G91       coordenadas absolutas / relativas
+ *   G92 X Y         fija la posicion actual
+ *   M3 / M5         baja / sube el lapiz (tambien Z <= 0 / Z > 0)
+ *   M2 / M30        fin: sube el lapiz y vuelve al menu
+ * Ctrl-X cancela en cualquier momento. ';' y '(...)' son comentarios.
+ *
+ * Control de flujo: cada linea procesada contesta "ok" o "error: ...".
+ * El host puede esperar el "ok" o contar caracteres (hasta RX_BUFFER_SIZE
+ * sin confirmar); ademas el receptor manda XOFF/XON segun se llene el buffer.
+ */
+
+
+#ifndef GCODE_H_
+#define GCODE_H_
+
+#include <stdint.h>
+
+#define GC_LINEA_MAX   48          // caracteres por linea (sin comentarios)
+#define GC_COLA        2           // comandos ya interpretados
+#define GC_PLUMA_MS    100         // espera al mover el solenoide
+
+// Tipos de comando
+#define GC_NADA        0           // solo cambio de lapiz
+#define GC_RECTA       1           // x, y = desplazamiento
+#define GC_ARCO_H      2           // x, y = desplazamiento; i, j = centro
+#define GC_ARCO_A      3
+#define GC_PAUSA       4           // x = ms
+#define GC_FIN         5
+
+// Estado del lapiz pedido por un comando
+#define GC_PLUMA_IGUAL  0
+#define GC_PLUMA_ABAJO  1
+#define GC_PLUMA_ARRIBA 2
+
+typedef struct {
+	uint8_t tipo;
+	uint8_t pluma;
+	int16_t x, y;
+	int16_t i, j;
+} GcComando;
+
+void gcode_iniciar(void);
+uint8_t gcode_activo(void);
+void gcode_servicio(void);         // llamar en cada vuelta del lazo principal
+
+#endif /* GCODE_H_ */
@@ -8,17 +8,32 @@
 #include <util/delay.h>
 #include <avr/interrupt.h>
 #include <string.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include <math.h>
 #include <avr/pgmspace.h>
 
 // Seccion para USART
 #define F_CPU 16000000UL    // Frecuencia del reloj del micro (16 MHz)
 #define BAUD 9600           // Velocidad de transmisión (baudios)
-#define BRC ((F_CPU / 16 / BAUD) - 1)   // Valor para UBRR
-#define TX_BUFFER_SIZE 128
-#define RX_BUFFER_SIZE 128
+#define BRC (((F_CPU / 8 + BAUD / 2) / BAUD) - 1)   // Valor para UBRR (doble velocidad, U2X0)
+#define TX_BUFFER_SIZE 128          // potencia de 2
+#define TX_MASK        (TX_BUFFER_SIZE - 1)
+#define RX_BUFFER_SIZE 128          // potencia de 2
+#define RX_XOFF_NIVEL  96           // con este llenado se le pide al host que pare
+#define RX_XON_NIVEL   32           // y con este que siga
+#define XON            0x11
+#define XOFF           0x13
+#define CANCELAR       0x18         // Ctrl-X
+
+// Que hacer cuando un mensaje no entra en el buffer de transmision (al
+// compilar; con DESCARTAR o CORTAR lo perdido se informa con la tecla p)
+#define TX_ESPERAR     0            // esperar a que la ISR lo vaya vaciando
+#define TX_DESCARTAR   1            // no mandar el mensaje
+#define TX_CORTAR      2            // mandar lo que entra
+#ifndef TX_POLITICA
+#define TX_POLITICA    TX_ESPERAR
+#endif
 #define precarger 10000
 
 // Direcciones base
@@ -65,21 +80,74 @@
 #define DR     10
 #define DL     11
 
-
+// Formato empaquetado de figuras (PK)
+// Cada byte lleva en el nibble bajo un codigo de direccion/solenoide (1..11)
+// o un codigo de operacion, y en el nibble alto un contador:
+//   [n-1 | dir]                      corrida de n pasos iguales (1..16)
+//   [n-1 | PAIR]  [a | b]            par a,b repetido n veces (1..16)
+//   [dir | LRUN]  [n-1]              corrida larga (1..256)
+//   [nH  | LPAIR] [nL] [a | b]       par largo, n-1 en 12 bits (1..4096)
+//   [0x00]                           fin de figura
+// Cada paso dura lo mismo que en ejecutar_circulo_sinc2 (150 ms).
+// Las tablas se generan con tools/plotter_pack.py.
+#define PK_OP_END    0x00
+#define PK_OP_PAIR   0x0C
+#define PK_OP_LRUN   0x0D
+#define PK_OP_LPAIR  0x0E
+
+#define PK_RUN(n, d)       (uint8_t)((((n) - 1) << 4) | (d))
+#define PK_PAIR(n, a, b)   (uint8_t)((((n) - 1) << 4) | PK_OP_PAIR), (uint8_t)(((a) << 4) | (b))
+#define PK_LRUN(n, d)      (uint8_t)(((d) << 4) | PK_OP_LRUN), (uint8_t)((n) - 1)
+#define PK_LPAIR(n, a, b)  (uint8_t)(((((n) - 1) >> 8) << 4) | PK_OP_LPAIR), (uint8_t)((n) - 1), (uint8_t)(((a) << 4) | (b))
+#define PK_END             PK_OP_END
+
+// Estado del decodificador (se lee la tabla de a un paso, sin copiarla a SRAM)
+typedef struct {
+	const uint8_t *p;   // proximo byte en flash
+	uint16_t resto;     // pasos que faltan del bloque actual
+	uint8_t a, b;       // codigos del bloque (b = 0 en corridas)
+	uint8_t fase;       // alterna entre a y b en los pares
+} PkDecoder;
+
+#include "motion.h"
+#include "motion.c"
+#include "trazo.h"
+#include "trazo.c"
+#include "transf.h"
+#include "transf.c"
+#include "fuente.h"
+#include "fuente.c"
+#include "../../comun/formato.h"
+#include "../../comun/formato.c"
+
+
+// Cola de transmision: un productor (lazo principal, mueve serialWritePos)
+// y un consumidor (ISR UDRE, mueve serialReadPos). Cada lado escribe solo
+// su indice, asi que no hace falta cli() para encolar.
 volatile char    serialBuffer[TX_BUFFER_SIZE];
 volatile uint8_t serialReadPos  = 0;
 volatile uint8_t serialWritePos = 0;
+#if TX_POLITICA != TX_ESPERAR
+uint16_t tx_perdidos = 0;           // caracteres descartados por buffer lleno (se informa con 'p')
+#endif
 
 volatile char    rxBuffer[RX_BUFFER_SIZE];
 volatile uint8_t rxReadPos  = 0;
 volatile uint8_t rxWritePos = 0;
-volatile uint8_t CONTADOR = 0; 
+volatile uint8_t rx_detenido = 0;   // se mando XOFF
+volatile uint8_t rx_cancelar = 0;   // llego Ctrl-X
+volatile char    tx_flujo = 0;      // XON/XOFF pendiente, sale antes que el buffer
 volatile const uint8_t radio = 10; 
 
 void appendSerial(char c);
 void serialWrite(const char *c);
+void serialWrite_P(const char *s);
+void serialWrite_n(const char *d, uint8_t n);
+uint8_t tx_libre(void);
 char peekChar(void);
 char Chardos(void);
+uint8_t rx_ocupado(void);
+void rx_vaciar(void);
 
 
 // macro para setear
@@ -101,253 +169,243 @@ void X(void);
 void Y(void);
 
 void centrar(void);
+void informar_posicion(void);
+void transf_tecla(char c);
+void texto_tecla(char c);
 void peurbas(char c);
 void dibujar_triangulo(void);
 void dibujar_cuadrado(void);
 void dibujar_cruz(void);
-static inline void generar_escalon(uint16_t ang_deg, const uint16_t tR[91], const uint16_t tU[91]);
 void Hacer_circulo(void);
-void Hacer_circulo_lut(void);
-void ejecutar_circulo(const uint8_t *tabla, uint16_t size);
-	
-
-
-const uint16_t Flor[] PROGMEM = {SOLENOID_DOWN,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,
-	DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,
-	LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,DOWN,DOWNLEFT,DOWN,
-	DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,
-	DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,
-	DOWNLEFT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,
-	DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNLEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,
-	LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,
-	UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,
-	LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,DOWNLEFT,LEFT,UPLEFT,DOWNLEFT,
-	LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,
-	DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,
-	LEFT,DOWNLEFT,LEFT,DOWNLEFT,DOWN,DOWNLEFT,LEFT,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,
-	DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,
-	DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,
-	DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,
-	DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,
-	DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,
-	DOWN,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,
-	DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,
-	RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,
-	DOWNRIGHT,UPRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,DOWN,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,DOWN,DOWNLEFT,DOWN,
-	DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,
-	DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,
-	DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,
-	DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,
-	DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,
-	DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,
-	RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,
-	DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,
-	RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,
-	UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,
-	RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,
-	UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,
-	UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,
-	UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,DOWNRIGHT,DOWN,
-	DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,
-	DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,
-	DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,
-	DOWN,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,
-	DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,
-	RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,
-	UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,
-	RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,
-	UPRIGHT,RIGHT,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,
-	UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,
-	UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UPLEFT,UPRIGHT,UP,UPLEFT,
-	UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,
-	UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,
-	UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,LEFT,UPLEFT,LEFT,
-	UPLEFT,LEFT,UPLEFT,UP,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,
-	RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,
-	UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,
-	RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,
-	UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,
-	UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,
-	UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,
-	UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,
-	UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,
-	LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,
-	UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,
-	LEFT,UPLEFT,LEFT,UPLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,
-	DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,
-	LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,
-	DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,UPLEFT,UPRIGHT,UP,UPRIGHT,
-	UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,
-	UPRIGHT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,
-	UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,
-	UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,
-	LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,
-	UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,
-	LEFT,UPLEFT,LEFT,UPLEFT,SOLENOID_UP,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN, DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,DOWN,SOLENOID_DOWN,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,
-		DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,
-		LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,LEFT,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,
-		DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,
-		DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,DOWNLEFT,DOWN,
-		DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,
-		DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,
-		DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,DOWN,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,
-		RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,
-		DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,DOWNRIGHT,RIGHT,UPRIGHT,
-		RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,
-		UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,
-		RIGHT,UPRIGHT,RIGHT,UPRIGHT,RIGHT,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,
-		UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,
-		UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPRIGHT,UP,UPLEFT,UP,
-		UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,
-		UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,UPLEFT,UP,
-		UPLEFT,UP,UPLEFT,UP,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,
-		LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,
-	UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,LEFT,UPLEFT,SOLENOID_UP};
-
-
-const uint16_t Murcielago[] PROGMEM = {DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT,
-	LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT,
-	DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT,
-	LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT,
-	DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, DOWN, DOWNRIGHT,
-	RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT,
-	DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT,
-	RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, DOWN,
-	DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT,
-	DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN,
-	DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWNLEFT, DOWN, DOWNRIGHT, DOWNLEFT, DOWN, DOWNLEFT,
-	DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN,
-	DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT,
-	RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT,
-	DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT,
-	RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN,
-	DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT,
-	DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN,
-	DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT,
-	RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT,
-	UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT,
-	RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT,
-	DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT,
-	RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN,
-	DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT,
-	DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, RIGHT, UPRIGHT, UP,
-	UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT,
-	UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP,
-	UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT,
-	RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT,
-	UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT,
-	RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT,
-	DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT,
-	RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP,
-	UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT,
-	UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP,
-	UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT,
-	RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT,
-	UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT,
-	RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, UP, UPRIGHT, UP, UPLEFT, UP, UPLEFT, UP,
-	UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT,
-	UP, UPLEFT, UP, UPLEFT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP,
-	UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT,
-	UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP,
-	UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT,
-	RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT,
-	UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT,
-	RIGHT, UPRIGHT, UP, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT,
-	UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT,
-	LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT,
-	UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT,
-	LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT,
-	DOWNLEFT, LEFT, UPLEFT, LEFT, DOWNLEFT, UPLEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT,
-	LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT,
-	DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT,
-	LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT,
-	DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT,
-	DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN,
-	DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT,
-	DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT,
-	DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT,
-	LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT,
-	UPLEFT, LEFT, UPLEFT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT,
-	UP, UPRIGHT, UP, UPLEFT, UP, UPRIGHT, UP, UPRIGHT, RIGHT, UPRIGHT, RIGHT, UPRIGHT, UP, UPRIGHT, UP,
-	UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT,
-	UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPRIGHT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP,
-	UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, LEFT, UPLEFT,
-	LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, DOWN, DOWNLEFT, DOWN,
-	DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT,
-	DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT,
-	UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT,
-	LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, LEFT, UPLEFT, UP,
-	UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT,
-	UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT,
-	UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, DOWNLEFT, LEFT, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT,
-	DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNLEFT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN,
-	DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT,
-	DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, RIGHT, DOWNRIGHT, RIGHT, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN,
-	DOWNLEFT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNRIGHT, DOWN, DOWNLEFT,
-	LEFT, DOWNLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT,
-	UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT,
-	LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP,
-	UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT,
-	UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP,
-	UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT, UP, UPLEFT,
-	UP, UPLEFT, UP, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT,
-	UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT,
-	LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT, UPLEFT, LEFT,
-UPLEFT, LEFT, UPLEFT, LEFT, STOP};
-
-const uint8_t CIRCLE_DATA[] PROGMEM = {
-   100, UP, 1, UP_RIGHT, 96, UP, 5, UP_RIGHT, 92, UP, 8, UP_RIGHT, 
-   88, UP, 10, UP_RIGHT, 85, UP, 19, UP_RIGHT, 81, UP, 23, UP_RIGHT,
-    77, UP, 27, UP_RIGHT, 73, UP, 32, UP_RIGHT, 68, UP, 36, UP_RIGHT,
-	 64, UP, 40, UP_RIGHT, 60, UP, 45, UP_RIGHT, 55, UP, 50, UP_RIGHT,
-	  50, UP, 54, UP_RIGHT, 46, UP, 59, UP_RIGHT, 41, UP, 65, UP_RIGHT,
-	   35, UP, 70, UP_RIGHT, 30, UP, 76, UP_RIGHT, 24, UP, 82, UP_RIGHT, 
-	   18, UP, 89, UP_RIGHT, 11, UP, 96, UP_RIGHT, 4, UP, 96, UP_RIGHT, 4,
-	    RIGHT, 89, UP_RIGHT, 11, RIGHT, 82, UP_RIGHT, 18, RIGHT, 76, UP_RIGHT, 
-		24, RIGHT, 70, UP_RIGHT, 30, RIGHT, 65, UP_RIGHT, 35, RIGHT, 59, UP_RIGHT, 41, 
-		RIGHT, 54, UP_RIGHT, 46, RIGHT, 50, UP_RIGHT, 50, RIGHT, 45, UP_RIGHT, 55, RIGHT, 40, 
-		UP_RIGHT, 60, RIGHT, 36, UP_RIGHT, 64, RIGHT, 32, UP_RIGHT, 68, RIGHT, 27, UP_RIGHT, 73, 
-		RIGHT, 23, UP_RIGHT, 77, RIGHT, 19, UP_RIGHT, 81, RIGHT, 15, UP_RIGHT, 85, RIGHT, 12,
-		UP_RIGHT, 88, RIGHT, 8, UP_RIGHT, 92, RIGHT, 4, UP_RIGHT, 96, RIGHT, 100, RIGHT,
-		
-		//Q2 (DOWN & RIGHT):
-		100, RIGHT, 4, DOWN_RIGHT, 96, RIGHT, 8, DOWN_RIGHT, 92, RIGHT, 12, DOWN_RIGHT, 88, RIGHT, 15,
-		 DOWN_RIGHT, 85, RIGHT, 19, DOWN_RIGHT, 81, RIGHT, 23, DOWN_RIGHT, 77, RIGHT, 27, DOWN_RIGHT, 73, 
-		 RIGHT, 32, DOWN_RIGHT, 68, RIGHT, 36, DOWN_RIGHT, 64, RIGHT, 40, DOWN_RIGHT, 60, RIGHT, 45, DOWN_RIGHT, 
-		 55, RIGHT, 50, DOWN_RIGHT, 50, RIGHT, 54, DOWN_RIGHT, 46, RIGHT, 59, DOWN_RIGHT, 41, RIGHT, 65,
-		  DOWN_RIGHT, 35, RIGHT, 70, DOWN_RIGHT, 30, RIGHT, 76, DOWN_RIGHT, 24, RIGHT, 82, DOWN_RIGHT, 18, 
-		  RIGHT, 89, DOWN_RIGHT, 11, RIGHT, 96, DOWN_RIGHT, 4, RIGHT, 96, DOWN_RIGHT, 4, DOWN, 89, DOWN_RIGHT,
-		   11, DOWN, 82, DOWN_RIGHT, 18, DOWN, 76, DOWN_RIGHT, 24, DOWN, 70, DOWN_RIGHT, 30, DOWN, 65, DOWN_RIGHT,
-		    35, DOWN, 59, DOWN_RIGHT, 41, DOWN, 54, DOWN_RIGHT, 46, DOWN, 50, DOWN_RIGHT, 50, DOWN, 45, DOWN_RIGHT,
-			 55, DOWN, 40, DOWN_RIGHT, 60, DOWN, 36, DOWN_RIGHT, 64, DOWN, 32, DOWN_RIGHT, 68, DOWN, 27, DOWN_RIGHT,
-			  73, DOWN, 23, DOWN_RIGHT, 77, DOWN, 19, DOWN_RIGHT, 81, DOWN, 15, DOWN_RIGHT, 85, DOWN, 12, DOWN_RIGHT,
-			   88, DOWN, 8, DOWN_RIGHT, 92, DOWN, 4, DOWN_RIGHT, 65, DOWN,
-
-		//Q3 (LEFT & DOWN):
-		100, DOWN, 4, DOWN_LEFT, 96, DOWN, 8, DOWN_LEFT, 92, DOWN, 12, DOWN_LEFT, 88, DOWN, 15, DOWN_LEFT,
-		 85, DOWN, 19, DOWN_LEFT, 81, DOWN, 23, DOWN_LEFT, 77, DOWN, 27, DOWN_LEFT, 73, DOWN, 32, DOWN_LEFT, 
-		 68, DOWN, 36, DOWN_LEFT, 64, DOWN, 40, DOWN_LEFT, 60, DOWN, 45, DOWN_LEFT, 55, DOWN, 50, DOWN_LEFT,
-		  50, DOWN, 54, DOWN_LEFT, 46, DOWN, 59, DOWN_LEFT, 41, DOWN, 65, DOWN_LEFT, 35, DOWN, 70, DOWN_LEFT, 
-		  30, DOWN, 76, DOWN_LEFT, 24, DOWN, 82, DOWN_LEFT, 18, DOWN, 89, DOWN_LEFT, 11, DOWN, 96, DOWN_LEFT, 
-		  4, DOWN, 96, DOWN_LEFT, 4, LEFT, 89, DOWN_LEFT, 11, LEFT, 82, DOWN_LEFT, 18, LEFT, 76, DOWN_LEFT,
-		   24, LEFT, 70, DOWN_LEFT, 30, LEFT, 65, DOWN_LEFT, 35, LEFT, 59, DOWN_LEFT, 41, LEFT, 54, DOWN_LEFT, 
-		   46, LEFT, 50, DOWN_LEFT, 50, LEFT, 45, DOWN_LEFT, 55, LEFT, 40, DOWN_LEFT, 60, LEFT, 36, DOWN_LEFT, 
-		   64, LEFT, 32, DOWN_LEFT, 68, LEFT, 27, DOWN_LEFT, 73, LEFT, 23, DOWN_LEFT, 77, LEFT, 19, DOWN_LEFT, 
-		   81, LEFT, 15, DOWN_LEFT, 85, LEFT, 12, DOWN_LEFT, 88, LEFT, 8, DOWN_LEFT, 92, LEFT, 4, DOWN_LEFT,
-		    96, LEFT, 10, LEFT,
-
-		//Q4 (UP & LEFT):
-		100, LEFT, 4, UP_LEFT, 96, LEFT, 8, UP_LEFT, 92, LEFT, 12, UP_LEFT, 88, LEFT, 15, UP_LEFT, 85, LEFT, 
-		19, UP_LEFT, 81, LEFT, 23, UP_LEFT, 77, LEFT, 27, UP_LEFT, 73, LEFT, 32, UP_LEFT, 68, LEFT, 36, UP_LEFT, 
-		64, LEFT, 40, UP_LEFT, 60, LEFT, 45, UP_LEFT, 55, LEFT, 50, UP_LEFT, 50, LEFT, 54, UP_LEFT, 46, LEFT, 
-		59, UP_LEFT, 41, LEFT, 65, UP_LEFT, 35, LEFT, 70, UP_LEFT, 30, LEFT, 76, UP_LEFT, 24, LEFT, 82, 
-		UP_LEFT, 18, LEFT, 89, UP_LEFT, 11, LEFT, 96, UP_LEFT, 4, LEFT, 96, UP_LEFT, 4, UP, 89, UP_LEFT, 
-		11, UP, 82, UP_LEFT, 18, UP, 76, UP_LEFT, 24, UP, 70, UP_LEFT, 30, UP, 65, UP_LEFT, 35, UP, 62,
-		 UP_LEFT, 41, UP, 57, UP_LEFT, 46, UP, 57, UP_LEFT, 50, UP, 48, UP_LEFT, 55, UP, 44, UP_LEFT, 60,
-		  UP, 40, UP_LEFT, 64, UP, 36, UP_LEFT, 68, UP, 30, UP_LEFT, 73, UP, 26, UP_LEFT, 79, UP, 23,
-		   UP_LEFT, 85, UP, 18, UP_LEFT, 87, UP, 20, UP_LEFT, 90, UP, 10, UP_LEFT, 100, UP, 150, UP, 130, UP
-	};
-
+void ejecutar_circulo_sinc2(const uint8_t *tabla);
+void pk_init(PkDecoder *d, const uint8_t *tabla);
+uint8_t pk_next(PkDecoder *d);
+uint8_t pk_bloque(PkDecoder *d, Paso *p);
+
+void trabajo_iniciar(uint8_t tipo, const void *datos);
+void trabajo_cargar(void);
+void trabajo_abortar(void);
+uint8_t trabajo_activo(void);
+uint8_t trabajo_generar(Paso *p);
+void estimacion_agregar(void);
+void progreso_servicio(void);
+
+#include "gcode.h"
+#include "gcode.c"
+#include "telem.h"
+#include "telem.c"
+
+
+
+// Flor (formato PK): 1467 pasos en 131 bytes
+const uint8_t Flor[] PROGMEM = {
+	PK_RUN(1, SOLENOID_DOWN), PK_LPAIR(20, DOWNLEFT, LEFT), PK_LPAIR(18, DOWNLEFT, DOWN), PK_PAIR(9, DOWNRIGHT, DOWN),
+	PK_RUN(1, DOWNLEFT), PK_LPAIR(25, UPLEFT, LEFT), PK_RUN(1, DOWNLEFT), PK_RUN(1, LEFT),
+	PK_RUN(1, UPLEFT), PK_RUN(1, DOWNLEFT), PK_LPAIR(17, LEFT, DOWNLEFT), PK_RUN(1, DOWN),
+	PK_RUN(1, DOWNLEFT), PK_RUN(1, LEFT), PK_RUN(1, DOWNLEFT), PK_LPAIR(23, DOWN, DOWNLEFT),
+	PK_LPAIR(19, DOWN, DOWNRIGHT), PK_LPAIR(22, RIGHT, DOWNRIGHT), PK_RUN(1, UPRIGHT), PK_PAIR(2, RIGHT, DOWNRIGHT),
+	PK_RUN(1, DOWN), PK_PAIR(2, DOWNLEFT, LEFT), PK_LPAIR(23, DOWNLEFT, DOWN), PK_LPAIR(21, DOWNRIGHT, DOWN),
+	PK_LPAIR(20, RIGHT, DOWNRIGHT), PK_LPAIR(18, RIGHT, UPRIGHT), PK_LPAIR(24, UP, UPRIGHT), PK_RUN(1, DOWNRIGHT),
+	PK_LPAIR(24, DOWN, DOWNRIGHT), PK_PAIR(16, RIGHT, DOWNRIGHT), PK_LPAIR(22, RIGHT, UPRIGHT), PK_LPAIR(19, UP, UPRIGHT),
+	PK_RUN(1, UPLEFT), PK_RUN(1, UPRIGHT), PK_LPAIR(22, UP, UPLEFT), PK_PAIR(3, LEFT, UPLEFT),
+	PK_RUN(1, UP), PK_RUN(1, UPRIGHT), PK_LPAIR(24, RIGHT, UPRIGHT), PK_LPAIR(18, UP, UPRIGHT),
+	PK_LPAIR(23, UP, UPLEFT), PK_LPAIR(17, LEFT, UPLEFT), PK_LPAIR(26, LEFT, DOWNLEFT), PK_RUN(1, UPLEFT),
+	PK_RUN(1, UPRIGHT), PK_PAIR(9, UP, UPRIGHT), PK_LPAIR(19, UP, UPLEFT), PK_LPAIR(20, LEFT, UPLEFT),
+	PK_RUN(1, SOLENOID_UP), PK_LRUN(100, DOWN), PK_RUN(1, SOLENOID_DOWN), PK_RUN(1, DOWNLEFT),
+	PK_LPAIR(18, LEFT, DOWNLEFT), PK_LPAIR(18, DOWN, DOWNLEFT), PK_LPAIR(19, DOWN, DOWNRIGHT), PK_LPAIR(18, RIGHT, DOWNRIGHT),
+	PK_LPAIR(19, RIGHT, UPRIGHT), PK_LPAIR(18, UP, UPRIGHT), PK_LPAIR(19, UP, UPLEFT), PK_LPAIR(18, LEFT, UPLEFT),
+	PK_RUN(1, SOLENOID_UP), PK_END
+};
+
+// Murcielago (formato PK): 1324 pasos en 141 bytes
+const uint8_t Murcielago[] PROGMEM = {
+	PK_RUN(1, DOWNLEFT), PK_LPAIR(36, LEFT, DOWNLEFT), PK_RUN(1, DOWN), PK_RUN(1, DOWNRIGHT),
+	PK_LPAIR(22, RIGHT, DOWNRIGHT), PK_LPAIR(20, DOWN, DOWNRIGHT), PK_RUN(1, DOWNLEFT), PK_RUN(1, DOWN),
+	PK_RUN(1, DOWNRIGHT), PK_RUN(1, DOWNLEFT), PK_PAIR(11, DOWN, DOWNLEFT), PK_PAIR(2, DOWN, DOWNRIGHT),
+	PK_RUN(1, RIGHT), PK_RUN(1, DOWNRIGHT), PK_PAIR(5, RIGHT, UPRIGHT), PK_LPAIR(18, RIGHT, DOWNRIGHT),
+	PK_LPAIR(20, DOWN, DOWNRIGHT), PK_PAIR(15, RIGHT, UPRIGHT), PK_LPAIR(24, RIGHT, DOWNRIGHT), PK_PAIR(16, DOWN, DOWNRIGHT),
+	PK_RUN(1, RIGHT), PK_PAIR(16, UPRIGHT, UP), PK_LPAIR(25, UPRIGHT, RIGHT), PK_PAIR(16, DOWNRIGHT, RIGHT),
+	PK_RUN(1, UPRIGHT), PK_LPAIR(21, UP, UPRIGHT), PK_LPAIR(17, RIGHT, UPRIGHT), PK_PAIR(5, RIGHT, DOWNRIGHT),
+	PK_PAIR(2, RIGHT, UPRIGHT), PK_RUN(1, UP), PK_RUN(1, UPRIGHT), PK_PAIR(12, UP, UPLEFT),
+	PK_LPAIR(21, UP, UPRIGHT), PK_LPAIR(23, RIGHT, UPRIGHT), PK_RUN(1, UP), PK_LPAIR(36, UPLEFT, LEFT),
+	PK_RUN(1, DOWNLEFT), PK_RUN(1, LEFT), PK_RUN(1, UPLEFT), PK_RUN(1, LEFT),
+	PK_RUN(1, DOWNLEFT), PK_RUN(1, UPLEFT), PK_RUN(1, DOWNLEFT), PK_LPAIR(27, LEFT, DOWNLEFT),
+	PK_LPAIR(27, DOWN, DOWNLEFT), PK_LPAIR(17, LEFT, DOWNLEFT), PK_PAIR(2, LEFT, UPLEFT), PK_RUN(1, UP),
+	PK_PAIR(7, UPRIGHT, UP), PK_RUN(1, UPLEFT), PK_PAIR(2, UP, UPRIGHT), PK_PAIR(2, RIGHT, UPRIGHT),
+	PK_PAIR(13, UP, UPRIGHT), PK_PAIR(10, UP, UPLEFT), PK_RUN(1, LEFT), PK_RUN(1, UPLEFT),
+	PK_PAIR(6, LEFT, DOWNLEFT), PK_PAIR(13, DOWN, DOWNLEFT), PK_RUN(1, LEFT), PK_PAIR(9, UPLEFT, LEFT),
+	PK_PAIR(8, DOWNLEFT, LEFT), PK_PAIR(13, UPLEFT, UP), PK_PAIR(6, UPLEFT, LEFT), PK_RUN(1, DOWNLEFT),
+	PK_RUN(1, LEFT), PK_PAIR(9, DOWNLEFT, DOWN), PK_PAIR(13, DOWNRIGHT, DOWN), PK_PAIR(2, DOWNRIGHT, RIGHT),
+	PK_PAIR(2, DOWNRIGHT, DOWN), PK_RUN(1, DOWNLEFT), PK_RUN(1, DOWN), PK_PAIR(6, DOWNRIGHT, DOWN),
+	PK_PAIR(2, DOWNLEFT, LEFT), PK_LPAIR(18, UPLEFT, LEFT), PK_LPAIR(27, UPLEFT, UP), PK_LPAIR(23, UPLEFT, LEFT),
+	PK_END
+};
+
+
+
+// ------------------------------------------------------------------
+// Trabajos: figuras que el lazo principal va cargando en la cola
+// ------------------------------------------------------------------
+
+// Tipos de trabajo
+#define TRABAJO_NINGUNO  0
+#define TRABAJO_VECTOR   1   // lista de Tramo en flash, termina en TR_FIN
+#define TRABAJO_PK       2   // tabla en formato PK
+#define TRABAJO_ORIGEN   3   // vuelve a (0, 0) con el lapiz arriba
+#define TRABAJO_SECUENCIA 4  // lista de Trabajo en flash (solo en el catalogo)
+#define TRABAJO_TEXTO    5   // cadena en SRAM dibujada con la fuente de trazos
+
+#define PK_PASO_MS 150       // duracion de cada paso de una tabla PK
+
+typedef struct {
+	uint8_t tipo;
+	const void *datos;
+} Trabajo;
+
+void secuencia_iniciar(const Trabajo *lista);
+void catalogo_iniciar(uint8_t i);
+void lista_tecla(char c);
+void lista_agregar(uint8_t i);
+
+// Figuras vectoriales: vertices relativos en ms de motor por eje.
+// El motor de lineas (trazo.c) elige los pasos rectos y diagonales.
+const Tramo CRUZ[] PROGMEM = {
+	{SOLENOID_DOWN, 500, 0},
+	{TR_LINEA, 24000, 24000}, {TR_LINEA, -12000, -12000},
+	{TR_LINEA, -12000, 12000}, {TR_LINEA, 24000, -24000},
+	{SOLENOID_UP, 0, 0}, {TR_FIN, 0, 0}
+};
+
+const Tramo TRIANGULO[] PROGMEM = {
+	{SOLENOID_DOWN, 500, 0},
+	{TR_LINEA, 0, -27000}, {TR_LINEA, 12000, 12000}, {TR_LINEA, -12000, 12000},
+	{SOLENOID_UP, 0, 0}, {TR_FIN, 0, 0}
+};
+
+const Tramo CUADRADO[] PROGMEM = {
+	{STOP, 100, 0}, {SOLENOID_DOWN, 100, 0},
+	{TR_LINEA, 0, 2000}, {TR_LINEA, 2000, 0}, {TR_LINEA, 0, -2000}, {TR_LINEA, -2000, 0},
+	{SOLENOID_UP, 100, 0}, {TR_FIN, 0, 0}
+};
+
+// Estrella de 5 puntas (radio 12000), todos los lados con pendiente arbitraria
+const Tramo ESTRELLA[] PROGMEM = {
+	{SOLENOID_DOWN, 500, 0},
+	{TR_LINEA, -7053, -21708}, {TR_LINEA, 18466, 13416}, {TR_LINEA, -22826, 0},
+	{TR_LINEA, 18466, -13416}, {TR_LINEA, -7053, 21708},
+	{SOLENOID_UP, 0, 0}, {TR_FIN, 0, 0}
+};
+
+// Circulo de radio 3000: arranca en el punto de la izquierda, sentido horario
+const Tramo CIRCULO[] PROGMEM = {
+	{STOP, 100, 0}, {SOLENOID_DOWN, 0, 0},
+	{TR_ARCO, 3000, 180, -360},
+	{SOLENOID_UP, 200, 0}, {TR_FIN, 0, 0}
+};
+
+// Corazon: dos semicirculos sobre una V, desde la punta de abajo
+const Tramo CORAZON[] PROGMEM = {
+	{SOLENOID_DOWN, 500, 0},
+	{TR_LINEA, -6000, 6000},
+	{TR_ARCO, 3000, 180, -180}, {TR_ARCO, 3000, 180, -180},
+	{TR_LINEA, -6000, -6000},
+	{SOLENOID_UP, 0, 0}, {TR_FIN, 0, 0}
+};
+
+// Entrada y salida de cada tipo de trabajo. Las esperas de las figuras
+// PK quedan solo al principio y al final de la tarea: entre trabajos
+// seguidos (lista o secuencia) se pasa de una figura a la otra sin parar.
+const Paso SIN_PASOS[] PROGMEM  = {{0, 0}};
+const Paso PK_INICIO[] PROGMEM  = {{STOP, 1000}, {0, 0}};                    // Espera inicial
+const Paso PK_FIN[] PROGMEM     = {{STOP, 1000}, {SOLENOID_UP, 0}, {0, 0}};  // Espera final
+const Paso PK_SIGUE[] PROGMEM   = {{SOLENOID_UP, 0}, {0, 0}};                // Sale otro trabajo detras
+const Paso ORIGEN_INICIO[] PROGMEM = {{SOLENOID_UP, 200}, {0, 0}};           // Lapiz arriba antes de volver
+
+// Secuencia de la opcion 6
+const Tramo TRASLADO_INICIO[] PROGMEM  = {{TR_LINEA, 0, -300}, {TR_LINEA, 300, 0}, {TR_FIN, 0, 0}};
+const Tramo TRASLADO_DERECHA[] PROGMEM = {{TR_LINEA, 300, 0}, {TR_FIN, 0, 0}};
+const Tramo PAUSA[] PROGMEM            = {{STOP, 300, 0}, {TR_FIN, 0, 0}};
+
+const Trabajo SECUENCIA_6[] PROGMEM = {
+	{TRABAJO_VECTOR, TRASLADO_INICIO},
+	{TRABAJO_VECTOR, CRUZ},
+	{TRABAJO_VECTOR, TRASLADO_DERECHA},
+	{TRABAJO_PK,     Murcielago},
+	{TRABAJO_VECTOR, PAUSA},
+	{TRABAJO_PK,     Flor},
+	{TRABAJO_VECTOR, PAUSA},
+	{TRABAJO_VECTOR, TRIANGULO},
+	{TRABAJO_VECTOR, PAUSA},
+	{TRABAJO_VECTOR, CIRCULO},
+	{TRABAJO_NINGUNO, 0}
+};
+
+// Catalogo de figuras en flash: la tecla '1' es la primera entrada.
+// Cada figura es una tecla ('1'..'9'): no entran mas de 9.
+typedef struct {
+	char nombre[12];
+	uint8_t formato;      // TRABAJO_*
+	const void *datos;
+} Figura;
+
+const Figura CATALOGO[] PROGMEM = {
+	{"Murcielago", TRABAJO_PK,        Murcielago},
+	{"Flor",       TRABAJO_PK,        Flor},
+	{"Circulo",    TRABAJO_VECTOR,    CIRCULO},
+	{"Triangulo",  TRABAJO_VECTOR,    TRIANGULO},
+	{"Cruz",       TRABAJO_VECTOR,    CRUZ},
+	{"Secuencia",  TRABAJO_SECUENCIA, SECUENCIA_6},
+	{"Estrella",   TRABAJO_VECTOR,    ESTRELLA},
+	{"Corazon",    TRABAJO_VECTOR,    CORAZON},
+	{"Cuadrado",   TRABAJO_VECTOR,    CUADRADO},
+};
+#define CATALOGO_CANT (sizeof(CATALOGO) / sizeof(CATALOGO[0]))
+_Static_assert(CATALOGO_CANT <= 9, "el menu y la lista leen la figura como un solo digito");
+
+// Lista de trabajos cargada por la UART ('k'). Se ejecuta de corrido: la
+// figura siguiente se empieza a generar apenas se termino de encolar la
+// anterior, mientras esta todavia se dibuja.
+#define LISTA_SIZE    16                  // potencia de 2
+#define LISTA_MASK    (LISTA_SIZE - 1)
+#define LISTA_ORIGEN  0xFE                // vuelta al origen en lugar de figura
+
+uint8_t lista_trabajos[LISTA_SIZE];       // indices del catalogo
+uint8_t lista_entra = 0, lista_sale = 0;
+uint8_t lista_hechos = 0, lista_total = 0;
+uint8_t lista_leyendo = 0;                // 1 mientras se escribe la lista
+
+Trabajo trabajo = {TRABAJO_NINGUNO, 0};   // trabajo en curso
+const Trabajo *secuencia = 0;             // siguiente trabajo de la secuencia (flash)
+uint8_t trabajo_fase = 0;                 // 0 = entrada, 1 = cuerpo, 2 = salida
+uint8_t trabajo_seguido = 0;              // el trabajo viene justo detras de otro (sin espera de entrada)
+const Paso *trabajo_extra;                // lista de entrada/salida
+const Tramo *trabajo_tramo;               // TRABAJO_VECTOR
+Linea trabajo_linea;                      // segmento en curso de TRABAJO_VECTOR
+PkDecoder trabajo_pk;                     // TRABAJO_PK
+Arco trabajo_arco;                        // arco en curso de TRABAJO_VECTOR
+uint8_t origen_intentos;                  // TRABAJO_ORIGEN: rectas que se pueden agregar para corregir
+Transf trabajo_transf;                    // escala/giro/espejo de las figuras
+Texto trabajo_texto;                      // TRABAJO_TEXTO
+
+// Estimacion de tiempo para la telemetria
+uint8_t estimando = 0;                    // se estan generando pasos sin encolarlos
+int32_t estimado_x, estimado_y;           // donde queda el lapiz al final de lo estimado
+uint8_t lista_estimada = 0;               // proximo indice de la lista a estimar
+uint8_t estimacion_activa = 0;            // falta estimar parte de la tarea
+uint8_t tarea_en_curso = 0;               // progreso_servicio ya vio arrancar la tarea
+uint8_t telem_leyendo = 0;                // 'i': la tecla siguiente configura la telemetria
+
+// Texto a dibujar, escrito por la UART ('w')
+#define TEXTO_MAX 32
+char texto[TEXTO_MAX + 1];
+uint8_t texto_largo = 0;
+uint8_t texto_leyendo = 0;
+
+// Linea de configuracion de la transformacion ('t')
+#define TRANSF_LINEA_MAX 24
+char transf_linea[TRANSF_LINEA_MAX + 1];
+uint8_t transf_largo = 0;
+uint8_t transf_leyendo = 0;
 
 
 	
@@ -356,6 +414,7 @@ int main(void)
 	
 	UBRR0H = (BRC >> 8);
 	UBRR0L = BRC;
+	UCSR0A = (1 << U2X0);
 	
 	timer1_init_1ms();
 	
@@ -368,13 +427,28 @@ int main(void)
 	
 	DDRB |= (1 << PORTB0);
  	DDRD = 0b11111110;
+
+	transf_config(&trabajo_transf, 100, 0, 0);
 	
 	
 	
-	serialWrite("\nSelecciona la figura a dibujar:\n");
-	serialWrite("1 - Murcielago\n");
-	serialWrite("2 - Flor\n");
-	serialWrite("3 - Circulo\n");
+	serialWrite_P(PSTR("\nSelecciona la figura a dibujar:\n"));
+	for (uint8_t i = 0; i < CATALOGO_CANT; i++) {
+		appendSerial('1' + i);
+		serialWrite_P(PSTR(" - "));
+		serialWrite_P(CATALOGO[i].nombre);
+		serialWrite_P(PSTR("\n"));
+	}
+	serialWrite_P(PSTR("k - Lista de trabajos (ej: k124h + Enter)\n"));
+	serialWrite_P(PSTR("t - Escala/giro/espejo (ej: t e150 a30 m1 + Enter)\n"));
+	serialWrite_P(PSTR("w - Escribir texto (hasta Enter)\n"));
+	serialWrite_P(PSTR("g - Modo G-code\n"));
+	serialWrite_P(PSTR("m - Mezcla de ejes si/no\n"));
+	serialWrite_P(PSTR("p - Posicion\n"));
+	serialWrite_P(PSTR("h - Volver al origen\n"));
+	serialWrite_P(PSTR("o - Fijar origen aqui\n"));
+	serialWrite_P(PSTR("i - Telemetria (i0 apaga, i1..i9 cada N s, ib binaria, ia texto)\n"));
+	serialWrite_P(PSTR("x - Abortar\n"));
 
 	
 	
@@ -382,322 +456,669 @@ int main(void)
 	
     while(1)
     {
+		// En modo G-code la UART la lee el interprete
+		if (gcode_activo()) {
+			gcode_servicio();
+			continue;
+		}
+
 	    char c = Chardos();
 	    if (c != '\0') {
-		    serialWrite("Recibido: ");
+		    serialWrite_P(PSTR("Recibido: "));
 		    appendSerial(c);
 		    appendSerial('\n');
 	    }
 	    
-		
-		int sx, sy;
-					
-	    if (c == '1') {
-		    ejecutar_circulo_sinc2(Murcielago, sizeof(Murcielago));
-	    }
-		if (c == '2') {
-			ejecutar_circulo_sinc2(Flor, sizeof(Flor));
-					}
-		if (c == '3') {
-			Hacer_circulo2();
-		}
-		if (c == '4') {
-			dibujar_triangulo();
-		}
-		if (c == '5') {
-			dibujar_cruz();
-		}
-		if (c == '6') {
-			Bajar();
-			_delay_ms(300);
-			Derecha();
-			_delay_ms(300);
-			dibujar_cruz();
-			Derecha();
-			_delay_ms(300);
-		    ejecutar_circulo_sinc2(Murcielago, sizeof(Murcielago));
-		    _delay_ms(300);
-			ejecutar_circulo_sinc2(Flor, sizeof(Flor));
-			_delay_ms(300);
-			dibujar_triangulo();
-			_delay_ms(300);
-			Hacer_circulo2();
-			
+		// Escribiendo la lista: las teclas son trabajos
+		if (c != '\0' && lista_leyendo) {
+			lista_tecla(c);
+			c = '\0';
+		}
+		else if (c != '\0' && transf_leyendo) {
+			transf_tecla(c);
+			c = '\0';
+		}
+		else if (c != '\0' && texto_leyendo) {
+			texto_tecla(c);
+			c = '\0';
+		}
+		else if (c != '\0' && telem_leyendo) {
+			telem_leyendo = 0;
+			telem_tecla(c);
+			c = '\0';
+		}
+
+		// Mientras se dibuja solo se acepta abortar, la posicion, agregar a la
+		// lista o cambiar la telemetria
+		if (c != '\0' && c != 'x' && c != 'p' && c != 'k' && c != 'i' && trabajo_activo()) {
+			serialWrite_P(PSTR("Ocupado\n"));
+		}
+		else if (c >= '1' && c < '1' + CATALOGO_CANT) {
+			catalogo_iniciar(c - '1');
+		}
+		else if (c == 'w') {
+			texto_leyendo = 1;
+			texto_largo = 0;
+			serialWrite_P(PSTR("Texto:\n"));
+		}
+		else if (c == 't') {
+			transf_leyendo = 1;
+			transf_largo = 0;
+			serialWrite_P(PSTR("Transformacion (e = escala %, a = angulo, m = espejo 0/1):\n"));
+		}
+		else if (c == 'k') {
+			lista_leyendo = 1;
+			serialWrite_P(PSTR("Lista (numeros, h = origen, Enter termina):\n"));
+		}
+		else if (c == 'g') {
+			gcode_iniciar();
+		}
+		else if (c == 'm') {
+			motion_mezcla ^= 1;
+			serialWrite_P(motion_mezcla ? PSTR("Mezcla de ejes: si\n") : PSTR("Mezcla de ejes: no\n"));
+		}
+		else if (c == 'p') {
+			informar_posicion();
+		}
+		else if (c == 'h') {
+			trabajo_iniciar(TRABAJO_ORIGEN, 0);
+		}
+		else if (c == 'o') {
+			motion_origen();
+			informar_posicion();
+		}
+		else if (c == 'i') {
+			telem_leyendo = 1;
 		}
 	    else {
 		    peurbas(c);
 	    }
-    }
 
+		// Avance de la tarea y rellenar la cola de movimientos (no bloquean)
+		progreso_servicio();
+		trabajo_cargar();
     }
- 
-void timer1_init_1ms(void) {
-	// CTC: WGM12 = 1, WGM13:0 = 0100
-	TCCR1A = 0;
-	TCCR1B = 0;
-	TCCR1B |= (1 << WGM12);
 
-	// OCR1A = F_CPU / (prescaler * 1000) - 1
-	// Con prescaler 64 y F_CPU=16 MHz -> 16000000/64/1000 - 1 = 249
-	OCR1A = (uint16_t)(F_CPU / 64UL / 1000UL - 1);
+    }
 
-	// Arrancar con prescaler = 64 (CS11=1, CS10=1)
-	TCCR1B |= (1 << CS11) | (1 << CS10);
 
-	// Limpia cualquier bandera pendiente
-	TIFR1 = (1 << OCF1A);
+// Lee el proximo paso de una lista en flash. Devuelve 0 al llegar a {0, 0}
+uint8_t lista_paso(const Paso **l, Paso *p) {
+	p->cmd = pgm_read_byte(&(*l)->cmd);
+	if (p->cmd == 0) return 0;
+	p->ms = pgm_read_word(&(*l)->ms);
+	(*l)++;
+	return 1;
 }
 
-static inline void delay_ms_timer1(uint16_t ms) {
-	while (ms--) {
-		// Reinicia conteo y bandera
-		TCNT1 = 0;
-		TIFR1 = (1 << OCF1A);
-		// Espera hasta que ocurra la comparación (1 ms)
-		while ((TIFR1 & (1 << OCF1A)) == 0) { /* espera */ }
+// Deja listo un trabajo para empezar a generar pasos
+void trabajo_preparar(uint8_t tipo, const void *datos) {
+	trabajo.tipo = tipo;
+	trabajo.datos = datos;
+	trabajo_fase = 0;
+
+	switch (tipo) {
+		case TRABAJO_VECTOR:
+		trabajo_tramo = (const Tramo *)datos;
+		linea_init(&trabajo_linea, 0, 0);
+		arco_init(&trabajo_arco, 0, 0, 0, 0, 0);
+		transf_reiniciar(&trabajo_transf);
+		trabajo_extra = SIN_PASOS;
+		break;
+
+		case TRABAJO_PK:
+		pk_init(&trabajo_pk, (const uint8_t *)datos);
+		transf_reiniciar(&trabajo_transf);
+		trabajo_extra = trabajo_seguido ? SIN_PASOS : PK_INICIO;
+		break;
+
+		case TRABAJO_TEXTO:
+		texto_init(&trabajo_texto, (const char *)datos);
+		transf_reiniciar(&trabajo_transf);
+		trabajo_extra = SIN_PASOS;
+		break;
+
+		case TRABAJO_ORIGEN:
+		linea_init(&trabajo_linea, 0, 0);
+		origen_intentos = 4;
+		trabajo_extra = ORIGEN_INICIO;
+		break;
 	}
 }
 
+// Hay otro trabajo esperando detras del actual, en la secuencia o en la
+// lista (al estimar, en lo que falta estimar de la lista)
+uint8_t trabajo_hay_siguiente(void) {
+	if (secuencia && pgm_read_byte(&secuencia->tipo) != TRABAJO_NINGUNO) return 1;
+	return (estimando ? lista_estimada : lista_sale) != lista_entra;
+}
 
-// ---- Generar tablas seno/cos 0–90° ----
-void precompute_semicirculo_arrays_90(uint16_t I_ms, uint16_t tR90[90], uint16_t tU90[90]) {
-	for (uint16_t i = 0; i < 90; ++i) {
-		float th = (float)i * (float)M_PI / 180.0f;
-		float c = cosf(th);
-		float s = sinf(th);
-		if (c < 0) c = 0; else if (c > 1) c = 1;
-		if (s < 0) s = 0; else if (s > 1) s = 1;
-		tR90[i] = (uint16_t)lrintf(c * (float)I_ms);
-		tU90[i] = (uint16_t)lrintf(s * (float)I_ms);
+// Lista de salida de cada tipo de trabajo
+const Paso *trabajo_salida(uint8_t tipo) {
+	switch (tipo) {
+		case TRABAJO_PK:      return trabajo_hay_siguiente() ? PK_SIGUE : PK_FIN;
+		default:              return SIN_PASOS;
 	}
 }
 
-void Hacer_circulo2(void) {
-	delay_ms_timer1(100);
-	cli();
+// Prepara la figura i del catalogo (si es una secuencia, solo la deja lista)
+void catalogo_preparar(uint8_t i) {
+	uint8_t formato = pgm_read_byte(&CATALOGO[i].formato);
+	const void *datos = pgm_read_ptr(&CATALOGO[i].datos);
+
+	if (formato == TRABAJO_SECUENCIA) secuencia = (const Trabajo *)datos;
+	else trabajo_preparar(formato, datos);
+}
+
+// Saca el proximo elemento de la lista y lo informa. Devuelve 0 si no hay
+uint8_t lista_siguiente(void) {
+	if (lista_sale == lista_entra) {
+		if (lista_total) {
+			serialWrite_P(PSTR("Lista terminada\n"));
+			lista_hechos = lista_total = 0;
+		}
+		return 0;
+	}
 
-	Subir_s(); // baja el lápiz (solenoide)
+	uint8_t i = lista_trabajos[lista_sale];
+	lista_sale = (lista_sale + 1) & LISTA_MASK;
+	lista_hechos++;
 
-	uint16_t n = sizeof(CIRCLE_DATA); // bytes totales
-	for (uint16_t i = 0; i + 1 < n; i += 2) { // avanza de a pares (tiempo, comando)
-		uint8_t t   = pgm_read_byte(&CIRCLE_DATA[i]);     // tiempo en i
-		uint8_t cmd = pgm_read_byte(&CIRCLE_DATA[i + 1]); // comando en i+1
+	fmt_printf_P(PSTR("Lista %u/%u: "), lista_hechos, lista_total);
+	if (i == LISTA_ORIGEN) {
+		serialWrite_P(PSTR("Origen\n"));
+		trabajo_preparar(TRABAJO_ORIGEN, 0);
+	}
+	else {
+		serialWrite_P(CATALOGO[i].nombre);
+		serialWrite_P(PSTR("\n"));
+		catalogo_preparar(i);
+	}
+	return 1;
+}
 
-		switch (cmd) {
-			case UP:         Subir(); break;
-			case DOWN:       Bajar(); break;
-			case LEFT:       Izquierda(); break;
-			case RIGHT:      Derecha(); break;
-			case UP_RIGHT:   ArribaDerecha(); break;
-			case DOWN_RIGHT: AbajoDerecha(); break;
-			case DOWN_LEFT:  AbajoIzquierda(); break;
-			case UP_LEFT:    ArribaIzquierda(); break;
-			case SOLENOID_UP:   /* si lo agregás en la LUT */ apagar(); break;
-			case SOLENOID_DOWN: /* si lo agregás en la LUT */ Subir_s(); break;
-			default:         apagar(); break;
+// Pasa al siguiente trabajo de la secuencia o de la lista (o queda sin
+// trabajo). Si venia uno en curso, el nuevo sale seguido
+void trabajo_siguiente(void) {
+	trabajo_seguido = (trabajo.tipo != TRABAJO_NINGUNO);
+	trabajo.tipo = TRABAJO_NINGUNO;
+
+	for (;;) {
+		if (secuencia) {
+			uint8_t tipo = pgm_read_byte(&secuencia->tipo);
+			if (tipo != TRABAJO_NINGUNO) {
+				trabajo_preparar(tipo, pgm_read_ptr(&secuencia->datos));
+				secuencia++;
+				return;
+			}
+			secuencia = 0;
 		}
+		if (!lista_siguiente()) return;
+		if (trabajo.tipo != TRABAJO_NINGUNO) return;
+	}
+}
+
+void catalogo_iniciar(uint8_t i) {
+	secuencia = 0;
+	trabajo_seguido = 0;
+	catalogo_preparar(i);
+	if (trabajo.tipo == TRABAJO_NINGUNO) trabajo_siguiente();
+}
+
+// Arranca la lista si no hay nada en curso
+void lista_arrancar(void) {
+	if (trabajo.tipo == TRABAJO_NINGUNO && !secuencia) trabajo_siguiente();
+}
 
-		delay_ms_timer1(t);
-		// opcional: un mini gap entre pasos
-		// delay_ms_timer1(2);
+// Agrega un trabajo al final de la lista. Arranca al terminar de escribirla
+void lista_agregar(uint8_t i) {
+	uint8_t next = (lista_entra + 1) & LISTA_MASK;
+	if (next == lista_sale) {
+		serialWrite_P(PSTR("Lista llena\n"));
+		return;
 	}
+	lista_trabajos[lista_entra] = i;
+	lista_entra = next;
+	lista_total++;
+}
 
-	apagar();
-	sei();
-	delay_ms_timer1(200);
+// Tecla recibida mientras se escribe la lista
+void lista_tecla(char c) {
+	if (c >= '1' && c < '1' + CATALOGO_CANT) {
+		lista_agregar(c - '1');
+	}
+	else if (c == 'h') {
+		lista_agregar(LISTA_ORIGEN);
+	}
+	else if (c == '\n' || c == '\r') {
+		lista_leyendo = 0;
+		serialWrite_P(PSTR("Lista cargada\n"));
+		// Con una tarea en marcha lo agregado se suma a lo que falta
+		if (telem_activa()) estimacion_agregar();
+		lista_arrancar();
+	}
+	else if (c == 'x') {
+		trabajo_abortar();
+	}
+	else if (c != ' ' && c != ',') {
+		serialWrite_P(PSTR("?\n"));
+	}
 }
 
+void trabajo_iniciar(uint8_t tipo, const void *datos) {
+	secuencia = 0;
+	trabajo_seguido = 0;
+	trabajo_preparar(tipo, datos);
+}
 
-// ---- Dibujar círculo completo ----
-void Hacer_circulo(void) {
-	const uint16_t I_ms = 45;      // Duración base de cada paso
-	uint16_t tR90[90], tU90[90];   // Tablas seno/cos de 0–90°
+void secuencia_iniciar(const Trabajo *lista) {
+	secuencia = lista;
+	trabajo.tipo = TRABAJO_NINGUNO;
+	trabajo_siguiente();
+}
 
-	precompute_semicirculo_arrays_90(I_ms, tR90, tU90);
+// Hay algo dibujandose o por dibujar
+uint8_t trabajo_activo(void) {
+	return trabajo.tipo != TRABAJO_NINGUNO || motion_ocupado();
+}
 
-	delay_ms_timer1(100);
-	cli();
+void trabajo_abortar(void) {
+	secuencia = 0;
+	lista_sale = lista_entra;
+	lista_hechos = lista_total = 0;
+	lista_leyendo = 0;
+	trabajo.tipo = TRABAJO_NINGUNO;
+	tarea_en_curso = 0;
+	estimacion_activa = 0;
+	telem_parar();
+	motion_abort();
+}
 
-	Subir_s();   // Baja el lápiz
+// Paso de una figura vectorial: sigue el segmento en curso o lee el proximo tramo
+uint8_t vector_paso(Paso *p) {
+	for (;;) {
+		if (linea_paso(&trabajo_linea, p)) return 1;
+		if (arco_paso(&trabajo_arco, p)) return 1;
 
-	for (uint16_t ang = 0; ang < 360; ++ang) {
-		uint16_t q = ang / 90;      // Cuadrante actual (0–3)
-		uint16_t idx = ang % 90;    // Índice dentro del cuadrante (0–89)
+		uint8_t op = pgm_read_byte(&trabajo_tramo->op);
+		int16_t x  = (int16_t)pgm_read_word(&trabajo_tramo->x);
+		int16_t y  = (int16_t)pgm_read_word(&trabajo_tramo->y);
+		int16_t z  = (int16_t)pgm_read_word(&trabajo_tramo->z);
 
-		switch (q) {
-			case 0: // Q1: UP + RIGHT
-			Derecha();
-			delay_ms_timer1(tU90[idx]);
-			Subir();
-			delay_ms_timer1(tR90[idx]);
-			apagar2();
-			_delay_ms(10);
-			break;
-	
-			case 1: // Q2: DOWN + RIGHT
-			Bajar();
-			delay_ms_timer1(tU90[idx]);
-			Derecha();
-			delay_ms_timer1(tR90[idx]); 
-			apagar2();
-			_delay_ms(10);
-			break;
+		if (op == TR_FIN) return 0;
+		trabajo_tramo++;
 
-			case 2: // Q3: DOWN + LEFT
-			Izquierda();
-			delay_ms_timer1(tU90[idx]);
-			Bajar();
-			delay_ms_timer1(tR90[idx]);
-			apagar2();
-			_delay_ms(10);
-			break;
+		if (op == TR_LINEA) {
+			linea_init(&trabajo_linea, x, y);
+		}
+		else if (op == TR_ARCO) {
+			arco_polar(&trabajo_arco, x, y, z);
+		}
+		else {                 // solenoide o pausa: x = ms
+			p->cmd = op;
+			p->ms = (uint16_t)x;
+			return 1;
+		}
+	}
+}
 
-			case 3: // Q4: UP + LEFT
-			Subir();
-			delay_ms_timer1(tU90[idx]);
-			Izquierda();
-			delay_ms_timer1(tR90[idx]);
-			apagar2();
-			_delay_ms(10);
-			break;
+// Limita un desplazamiento a lo que entra en una recta
+static int16_t origen_tramo(int32_t v) {
+	if (v > 32767) return 32767;
+	if (v < -32767) return -32767;
+	return (int16_t)v;
+}
+
+// Paso de la vuelta al origen. La recta sale de donde va a quedar el lapiz
+// cuando termine lo encolado (o de la posicion estimada, al estimar); si el
+// redondeo de la recta (o el largo) no llega justo a (0, 0) se agrega otra
+// con lo que falta.
+uint8_t origen_paso(Paso *p) {
+	for (;;) {
+		if (linea_paso(&trabajo_linea, p)) return 1;
+
+		int32_t x, y;
+		if (estimando) {
+			x = estimado_x;
+			y = estimado_y;
+		}
+		else {
+			motion_destino(&x, &y);
 		}
+		if ((x == 0 && y == 0) || origen_intentos == 0) return 0;
+		origen_intentos--;
+		linea_init(&trabajo_linea, origen_tramo(-x), origen_tramo(-y));
 	}
+}
 
-	apagar();   // Apaga motores
-	sei();
-	delay_ms_timer1(200);
+// Paso del cuerpo del trabajo actual. Devuelve 0 cuando se termina
+uint8_t trabajo_cuerpo(Paso *p) {
+	switch (trabajo.tipo) {
+		case TRABAJO_VECTOR:
+		return vector_paso(p);
+
+		case TRABAJO_PK:
+		if (motion_mezcla) return pk_bloque(&trabajo_pk, p);
+		p->cmd = pk_next(&trabajo_pk);
+		if (p->cmd == 0 || p->cmd == STOP) return 0;
+		p->ms = PK_PASO_MS;
+		return 1;
+
+		case TRABAJO_TEXTO:
+		return texto_paso(&trabajo_texto, p);
+
+		case TRABAJO_ORIGEN:
+		return origen_paso(p);
+	}
+	return 0;
+}
+
+// Cuerpo de las figuras pasado por la transformacion. Los pasos que no
+// mueven (solenoide, pausas) salen igual, despues de lo ya transformado.
+uint8_t trabajo_cuerpo_transf(Paso *p) {
+	if (trabajo_transf.identidad || trabajo.tipo == TRABAJO_ORIGEN) return trabajo_cuerpo(p);
+
+	for (;;) {
+		if (transf_sacar(&trabajo_transf, p)) return 1;
+		*p = (Paso){0, 0, 0, 0};
+		if (!trabajo_cuerpo(p)) {
+			// Fin de la figura: se dibuja lo que quedo de los redondeos
+			transf_cerrar(&trabajo_transf);
+			return transf_sacar(&trabajo_transf, p);
+		}
+		if (!transf_meter(&trabajo_transf, p)) return 1;
+		*p = (Paso){0, 0, 0, 0};
+	}
+}
+
+// Proximo paso del trabajo actual: entrada, cuerpo y salida.
+// Devuelve 0 cuando el trabajo termino (no pasa al siguiente).
+uint8_t trabajo_generar(Paso *p) {
+	for (;;) {
+		if (trabajo_fase == 0) {
+			if (lista_paso(&trabajo_extra, p)) return 1;
+			trabajo_fase = 1;
+		}
+		else if (trabajo_fase == 1) {
+			if (trabajo_cuerpo_transf(p)) return 1;
+			trabajo_extra = trabajo_salida(trabajo.tipo);
+			trabajo_fase = 2;
+		}
+		else {
+			return lista_paso(&trabajo_extra, p);
+		}
+	}
 }
- void dibujar_cruz(void){
-	 Subir_s();
-	 _delay_ms(500);
-	 ArribaDerecha();
-	 _delay_ms(24000);
-	 AbajoIzquierda();
-	 _delay_ms(12000);
-	ArribaIzquierda();
-	_delay_ms(12000);
-	AbajoDerecha();
-	_delay_ms(24000);
-	 apagar();
-	 
- }
- 
- void dibujar_triangulo(void){
-	
-		Subir_s();
-		_delay_ms(500);
-		Bajar();   
-		_delay_ms(27000); 
-		ArribaDerecha();  
-		_delay_ms(12000);
-		ArribaIzquierda();   
-		_delay_ms(12000);
-		
-		apagar();
-		
- }
-		
- void dibujar_cuadrado(void){
-	 
-	_delay_ms(100);
-	 Subir_s();          
-	 _delay_ms(100);
-	CONTADOR = 0;
-	
-	
-	 while (CONTADOR < 2) { Subir();     }   // 2 s
-	 while (CONTADOR < 4) { Derecha();   }   // 2 s
-	 while (CONTADOR < 6) { Bajar();     }   // 2 s
-	 while (CONTADOR < 8) { Izquierda(); }   // 2 s
-	 //x
-	 
-	  _delay_ms(100);
-	 apagar();
-	 _delay_ms(100);
-	 
- }
 
+// Genera un paso del trabajo actual y lo encola si hay lugar.
+// Se llama en cada vuelta del lazo principal: un paso por llamada para
+// que la UART se siga atendiendo enseguida.
+void trabajo_cargar(void) {
+	Paso p = {0, 0, 0, 0};
 
-void ejecutar_circulo_sinc(const uint8_t *tablaDir, const uint8_t *tablaTime, uint16_t size) {
-	uint8_t cmd;
-	uint8_t t;
+	if (trabajo.tipo == TRABAJO_NINGUNO || motion_libre() == 0) return;
 
-	_delay_ms(1000);  // Espera inicial
+	while (!trabajo_generar(&p)) {
+		trabajo_siguiente();
+		if (trabajo.tipo == TRABAJO_NINGUNO) return;
+	}
 
-	for (uint16_t i = 0; i < size; i++) {
-		cmd = pgm_read_byte(&tablaDir[i]);   // dirección
-		t   = pgm_read_byte(&tablaTime[i]);  // tiempo correspondiente
+	motion_push_paso(&p);
+}
 
-		if (cmd == STOP)
-		break;
+// ------------------------------------------------------------------
+// Estimacion de tiempo: se generan los pasos de la tarea sin encolarlos
+// y se suman sus ms. Es exacta mientras no cambie la mezcla de ejes.
+// Se hace de a ESTIMAR_PASOS por vuelta del lazo principal sobre una
+// copia del generador, asi una figura larga no deja la cola sin pasos.
+// ------------------------------------------------------------------
+
+#define ESTIMAR_PASOS  8          // pasos estimados por vuelta del lazo
+
+// Copia del estado del generador, para recorrerlo y dejarlo como estaba
+typedef struct {
+	Trabajo trabajo;
+	const Trabajo *secuencia;
+	uint8_t fase;
+	uint8_t seguido;
+	const Paso *extra;
+	const Tramo *tramo;
+	Linea linea;
+	PkDecoder pk;
+	Arco arco;
+	uint8_t origen_intentos;
+	Transf transf;
+	Texto texto;
+} Generador;
+
+static Generador estimacion;      // donde quedo la estimacion entre vuelta y vuelta
+
+static void generador_guardar(Generador *g) {
+	g->trabajo = trabajo;
+	g->secuencia = secuencia;
+	g->fase = trabajo_fase;
+	g->seguido = trabajo_seguido;
+	g->extra = trabajo_extra;
+	g->tramo = trabajo_tramo;
+	g->linea = trabajo_linea;
+	g->pk = trabajo_pk;
+	g->arco = trabajo_arco;
+	g->origen_intentos = origen_intentos;
+	g->transf = trabajo_transf;
+	g->texto = trabajo_texto;
+}
 
-		// Ejecutar la acción según comando
-		switch (cmd) {
-			case UP:            Subir(); break;
-			case DOWN:          Bajar(); break;
-			case LEFT:          Izquierda(); break;
-			case RIGHT:         Derecha(); break;
+static void generador_restaurar(const Generador *g) {
+	trabajo = g->trabajo;
+	secuencia = g->secuencia;
+	trabajo_fase = g->fase;
+	trabajo_seguido = g->seguido;
+	trabajo_extra = g->extra;
+	trabajo_tramo = g->tramo;
+	trabajo_linea = g->linea;
+	trabajo_pk = g->pk;
+	trabajo_arco = g->arco;
+	origen_intentos = g->origen_intentos;
+	trabajo_transf = g->transf;
+	trabajo_texto = g->texto;
+}
 
-			case UP_LEFT:       ArribaIzquierda(); break;
-			case UP_RIGHT:      ArribaDerecha(); break;
-			case DOWN_LEFT:     AbajoIzquierda(); break;
-			case DOWN_RIGHT:    AbajoDerecha(); break;
+// Arranca la estimacion de la tarea que empieza: el trabajo en curso con
+// su secuencia y lo que queda de la lista. La cola tiene que estar vacia
+// (se parte de donde va a quedar el lapiz).
+static void estimacion_iniciar(void) {
+	generador_guardar(&estimacion);
+	motion_destino(&estimado_x, &estimado_y);
+	lista_estimada = lista_sale;
+	estimacion_activa = 1;
+}
 
-			case SOLENOID_UP:   apagar(); break;
-			case SOLENOID_DOWN: Subir_s(); break;
+// Se agrego a la lista con la tarea en marcha. Si la estimacion sigue
+// corriendo lo toma sola; si no, sigue desde donde termino.
+void estimacion_agregar(void) {
+	if (estimacion_activa) return;
+	estimacion_activa = 1;
+	telem_total_listo(0);
+}
 
-			default:            apagar(); break;
+// Un tramo de la estimacion: como mucho ESTIMAR_PASOS pasos o trabajos
+// preparados. Con la telemetria apagada queda en pausa.
+static void estimacion_servicio(void) {
+	Generador vivo;
+	Paso p;
+	uint32_t ms = 0;
+	uint8_t n = ESTIMAR_PASOS;
+
+	if (!estimacion_activa || telem_periodo() == 0) return;
+
+	generador_guardar(&vivo);
+	generador_restaurar(&estimacion);
+	estimando = 1;
+
+	while (n--) {
+		if (trabajo.tipo != TRABAJO_NINGUNO) {
+			p = (Paso){0, 0, 0, 0};
+			if (trabajo_generar(&p)) {
+				ms += p.ms;
+				motion_mover(p.cmd, p.ms - p.menor, &estimado_x, &estimado_y);
+				motion_mover(p.cmd2, p.menor, &estimado_x, &estimado_y);
+				continue;
+			}
+			trabajo.tipo = TRABAJO_NINGUNO;
 		}
 
-		for (uint8_t j = 0; j < t; j++) {
-			_delay_ms(10);
+		// Trabajo siguiente, como trabajo_siguiente pero sin informarlo
+		trabajo_seguido = 1;
+		if (secuencia) {
+			uint8_t tipo = pgm_read_byte(&secuencia->tipo);
+			if (tipo != TRABAJO_NINGUNO) {
+				trabajo_preparar(tipo, pgm_read_ptr(&secuencia->datos));
+				secuencia++;
+			}
+			else {
+				secuencia = 0;
+			}
+		}
+		else if (lista_estimada != lista_entra) {
+			uint8_t i = lista_trabajos[lista_estimada];
+			lista_estimada = (lista_estimada + 1) & LISTA_MASK;
+			if (i == LISTA_ORIGEN) trabajo_preparar(TRABAJO_ORIGEN, 0);
+			else catalogo_preparar(i);
+		}
+		else {
+			estimacion_activa = 0;
+			break;
 		}
-
 	}
 
-	_delay_ms(1000);  // Espera final
-	apagar();
+	estimando = 0;
+	generador_guardar(&estimacion);
+	generador_restaurar(&vivo);
+
+	telem_sumar(ms);
+	if (!estimacion_activa) telem_total_listo(1);
 }
 
-void ejecutar_circulo_sinc2(const uint16_t *tablaDir, uint16_t size) {
-	uint8_t cmd;
+// Telemetria: cuando arranca una tarea se empieza a estimar cuanto va a
+// tardar y, con la estimacion completa, se informa el avance. Va antes de
+// trabajo_cargar, asi la estimacion arranca con la cola todavia vacia.
+// Con la telemetria apagada (periodo 0) la tarea no se estima.
+void progreso_servicio(void) {
+	if (!tarea_en_curso && trabajo.tipo != TRABAJO_NINGUNO) {
+		tarea_en_curso = 1;
+		if (telem_periodo()) {
+			telem_iniciar();
+			estimacion_iniciar();
+		}
+	}
+	else if (tarea_en_curso && !trabajo_activo()) {
+		tarea_en_curso = 0;
+		estimacion_activa = 0;
+		telem_terminar();
+	}
+	else {
+		estimacion_servicio();
+	}
+	telem_servicio();
+}
 
-	_delay_ms(1000);  // Espera inicial
+// ---- Dibujar círculo completo ----
+void Hacer_circulo(void) {
+	trabajo_iniciar(TRABAJO_VECTOR, CIRCULO);
+}
 
-	for (uint16_t i = 0; i < size; i++) {
-		cmd = pgm_read_byte(&tablaDir[i]);   // dirección
+ void dibujar_cruz(void){
+	 trabajo_iniciar(TRABAJO_VECTOR, CRUZ);
+ }
+ 
+ void dibujar_triangulo(void){
+	 trabajo_iniciar(TRABAJO_VECTOR, TRIANGULO);
+ }
 		
+ void dibujar_cuadrado(void){
+	 trabajo_iniciar(TRABAJO_VECTOR, CUADRADO);
+ }
 
-		if (cmd == STOP)
-		break;
 
-		// Ejecutar la acción según comando
-		switch (cmd) {
-			case UP:            Subir(); break;
-			case DOWN:          Bajar(); break;
-			case LEFT:          Izquierda(); break;
-			case RIGHT:         Derecha(); break;
+// Prepara el decodificador al inicio de una tabla PK
+void pk_init(PkDecoder *d, const uint8_t *tabla) {
+	d->p = tabla;
+	d->resto = 0;
+	d->a = 0;
+	d->b = 0;
+	d->fase = 0;
+}
 
-			case UPLEFT:       ArribaIzquierda(); break;
-			case UPRIGHT:      ArribaDerecha(); break;
-			case DOWNLEFT:     AbajoIzquierda(); break;
-			case DOWNRIGHT:    AbajoDerecha(); break;
+// Devuelve el proximo paso de la tabla PK, o 0 al llegar al final
+uint8_t pk_next(PkDecoder *d) {
+	if (d->resto == 0) {
+		uint8_t c  = pgm_read_byte(d->p);
+		uint8_t op = c & 0x0F;
+		uint8_t hi = c >> 4;
+
+		if (op == PK_OP_END || op > PK_OP_LPAIR) return 0;   // queda parado en el fin
+		d->p++;
+		d->b = 0;
+		d->fase = 0;
+
+		if (op < PK_OP_PAIR) {              // corrida corta
+			d->a = op;
+			d->resto = hi + 1;
+		}
+		else if (op == PK_OP_LRUN) {        // corrida larga
+			d->a = hi;
+			d->resto = pgm_read_byte(d->p++) + 1;
+		}
+		else {                              // par corto o largo
+			uint16_t n = hi + 1;
+			if (op == PK_OP_LPAIR) {
+				n = (((uint16_t)hi << 8) | pgm_read_byte(d->p++)) + 1;
+			}
+			uint8_t par = pgm_read_byte(d->p++);
+			d->a = par >> 4;
+			d->b = par & 0x0F;
+			d->resto = 2 * n;
+		}
+	}
 
-			case SOLENOID_UP:   apagar(); break;
-			case SOLENOID_DOWN: Subir_s(); break;
+	uint8_t cmd = d->a;
+	if (d->b) {
+		if (d->fase) cmd = d->b;
+		d->fase ^= 1;
+	}
+	d->resto--;
+	return cmd;
+}
 
-			default:            apagar(); break;
-		}
-		_delay_ms(150);
+// Devuelve lo que queda del bloque PK actual como un solo paso: las
+// corridas enteras y los pares como mezcla de sus dos direcciones
+uint8_t pk_bloque(PkDecoder *d, Paso *p) {
+	uint8_t cmd = pk_next(d);           // abre el bloque si hace falta
+	if (cmd == 0 || cmd == STOP) return 0;
+
+	uint16_t n = d->resto;              // pasos que quedan despues de este
+	if (n > 0xFFFF / PK_PASO_MS - 1) n = 0xFFFF / PK_PASO_MS - 1;
+
+	p->cmd = cmd;
+	p->ms = (n + 1) * PK_PASO_MS;
+	if (d->b) {
+		// Alternan empezando por la otra direccion: le tocan (n + 1) / 2
+		p->cmd2 = (cmd == d->a) ? d->b : d->a;
+		p->menor = ((n + 1) / 2) * PK_PASO_MS;
+		if (n & 1) d->fase ^= 1;
 	}
+	d->resto -= n;
+	return 1;
+}
 
-	_delay_ms(1000);  // Espera final
-	apagar();
+// Dibuja una tabla PK (pasos de 150 ms) sin bloquear
+void ejecutar_circulo_sinc2(const uint8_t *tabla) {
+	trabajo_iniciar(TRABAJO_PK, tabla);
 }
 
 void peurbas(char c){
 	switch (c) {
-		case 'x': apagar(); break;
+		case 'x': trabajo_abortar(); break;
 		case 's': Subir_s(); break;
 		case 'u': Subir(); break;
 		case 'd': Bajar(); break;
@@ -712,105 +1133,153 @@ void peurbas(char c){
 	}
 }
 
-void centrar(void){
-	CONTADOR = 0;
-	TCNT1H = 0xC2;
-	TCNT1L = 0xF7;
-	
-	while(CONTADOR < 6){
-		AbajoDerecha();
-	}
-	apagar();
+// Informa la transformacion actual
+void transf_informar(void) {
+	fmt_printf_P(PSTR("Escala %d %%, angulo %d, espejo %S\n"), trabajo_transf.escala,
+	             trabajo_transf.angulo, trabajo_transf.espejo ? PSTR("si") : PSTR("no"));
 }
 
-
-void apagar(void){
-
-PORTD = (PORTD & 0b00000011) | 0b00001000;
-
+// Interpreta "e150 a30 m1" (cualquier orden, los que falten no cambian)
+void transf_aplicar(const char *l) {
+	int16_t escala = trabajo_transf.escala;
+	int16_t angulo = trabajo_transf.angulo;
+	uint8_t espejo = trabajo_transf.espejo;
+
+	while (*l) {
+		char letra = *l++;
+		if (letra == ' ') continue;
+
+		char *fin;
+		long v = strtol(l, &fin, 10);
+		if (fin == l) {
+			serialWrite_P(PSTR("error: numero\n"));
+			return;
+		}
+		l = fin;
+
+		if (letra == 'e' && v >= TRANSF_ESCALA_MIN && v <= TRANSF_ESCALA_MAX) escala = (int16_t)v;
+		else if (letra == 'a' && v > -3600 && v < 3600) angulo = (int16_t)v;
+		else if (letra == 'm' && (v == 0 || v == 1)) espejo = (uint8_t)v;
+		else {
+			serialWrite_P(PSTR("error: valor\n"));
+			return;
+		}
+	}
+	transf_config(&trabajo_transf, escala, angulo, espejo);
 }
 
-void apagar2(void){
-
-	PORTD = (PORTD & 0b00001111) | 0b00000000;
-
+// Tecla recibida mientras se escribe la transformacion
+void transf_tecla(char c) {
+	if (c == '\n' || c == '\r') {
+		transf_linea[transf_largo] = '\0';
+		transf_leyendo = 0;
+		transf_aplicar(transf_linea);
+		transf_informar();
+	}
+	else if (transf_largo < TRANSF_LINEA_MAX) {
+		transf_linea[transf_largo++] = c;
+	}
 }
-void Subir_s(void)
-{
-PORTD = (PORTD & 0b00000011) | 0b00000100;
-
 
+// Tecla recibida mientras se escribe el texto: Enter lo dibuja
+void texto_tecla(char c) {
+	if (c == '\n' || c == '\r') {
+		texto[texto_largo] = '\0';
+		texto_leyendo = 0;
+		if (texto_largo) trabajo_iniciar(TRABAJO_TEXTO, texto);
+	}
+	else if (texto_largo < TEXTO_MAX) {
+		texto[texto_largo++] = c;
+	}
 }
 
-void Bajar(void)
-{
-PORTD = (PORTD & 0b00001111) | 0b00010000;
+// Vuelve al origen segun la posicion medida (antes era un traslado fijo)
+void centrar(void){
+	trabajo_iniciar(TRABAJO_ORIGEN, 0);
 }
 
-void Subir(void)
-{
-PORTD = (PORTD & 0b00001111) | 0b00100000;
-}
+// Manda la posicion actual por la UART: "Posicion: x y" en ms de motor
+void informar_posicion(void) {
+	int32_t x, y;
 
-void Izquierda(void)
-{
-PORTD = (PORTD & 0b00001111) | 0b01000000;
+	motion_posicion(&x, &y);
+	fmt_printf_P(PSTR("Posicion: %ld %ld\n"), x, y);
+#if TX_POLITICA != TX_ESPERAR
+	fmt_printf_P(PSTR("Salida perdida: %u caracteres\n"), tx_perdidos);
+#endif
 }
 
 
-void Derecha(void)
-{
-PORTD = (PORTD & 0b00001111) | 0b10000000;
-}
 
-void AbajoIzquierda(void)
-{
-	PORTD = (PORTD & 0b00001111) | 0b01010000; // D6 y D4
-}
 
-void AbajoDerecha(void){
-	PORTD = (PORTD & 0b00001111) | 0b10010000; // D6 y D4
+// Lugares libres en el buffer de transmision
+uint8_t tx_libre(void){
+	return TX_MASK - ((uint8_t)(serialWritePos - serialReadPos) & TX_MASK);
 }
-
-void ArribaIzquierda(void)
-{
-	PORTD = (PORTD & 0b00001111) | 0b01100000; // D3 y D4
-}
-
-void ArribaDerecha(void){
-	PORTD = (PORTD & 0b00001111) | 0b10100000; // D6 y D4
+// Cuantos de los n caracteres de un mensaje se escriben, segun la politica
+static uint16_t tx_reservar(uint16_t n){
+#if TX_POLITICA == TX_ESPERAR
+	return n;
+#else
+	uint8_t libre = tx_libre();
+	if (n <= libre) return n;
+#if TX_POLITICA == TX_DESCARTAR
+	libre = 0;
+#endif
+	tx_perdidos += n - libre;
+	return libre;
+#endif
 }
-
-
-ISR(TIMER1_OVF_vect) {
-	CONTADOR++;
-	TCNT1H = 0xC2;
-	TCNT1L = 0xF7;
+// Encola un caracter. Si esta lleno espera a la ISR (nunca se llama con
+// las interrupciones deshabilitadas)
+static inline void tx_poner(char c){
+	uint8_t next = (serialWritePos + 1) & TX_MASK;
+	while (next == serialReadPos){
+		UCSR0B |= (1 << UDRIE0);
+	}
+	serialBuffer[serialWritePos] = c;
+	serialWritePos = next;
 }
-
-
-
-
 void appendSerial(char c)
 {
-	serialBuffer[serialWritePos] = c;
-	serialWritePos++;
-
-	if (serialWritePos >= TX_BUFFER_SIZE) {
-		serialWritePos = 0;   // wrap-around
-	}
+	if (tx_reservar(1)) tx_poner(c);
+	UCSR0B |= (1 << UDRIE0);
+}
+// Igual que serialWrite pero con el texto en flash: se copia de a un
+// caracter directo al buffer, sin pasar por SRAM
+void serialWrite_P(const char *s){
+	uint16_t n = tx_reservar(strlen_P(s));
+	while (n--) tx_poner(pgm_read_byte(s++));
+	UCSR0B |= (1 << UDRIE0);
 }
 void serialWrite(const char *s){
-	for (uint8_t i = 0; i < (uint8_t)strlen(s); i++){
-		serialBuffer[serialWritePos] = s[i];
-		serialWritePos = (serialWritePos + 1) % TX_BUFFER_SIZE;
-	}
+	uint16_t n = tx_reservar(strlen(s));
+	while (n--) tx_poner(*s++);
 	UCSR0B |= (1 << UDRIE0);   // habilita ISR UDRE
 }
+// Bytes sueltos (pueden incluir '\0'), para la telemetria binaria
+void serialWrite_n(const char *d, uint8_t n){
+	n = (uint8_t)tx_reservar(n);
+	while (n--) tx_poner(*d++);
+	UCSR0B |= (1 << UDRIE0);
+}
+// Salida de fmt_printf_P: la politica se aplica a la linea entera
+void fmt_escribir(const char *d, uint8_t n){
+	serialWrite_n(d, n);
+}
+// Pide que se envie XON/XOFF sin esperar a lo que ya esta en el buffer
+static void enviar_flujo(char c)
+{
+	tx_flujo = c;
+	UCSR0B |= (1 << UDRIE0);
+}
 ISR(USART_UDRE_vect){
-	if (serialReadPos != serialWritePos){
+	if (tx_flujo){
+		UDR0 = tx_flujo;
+		tx_flujo = 0;
+		} else if (serialReadPos != serialWritePos){
 		UDR0 = serialBuffer[serialReadPos];
-		serialReadPos = (serialReadPos + 1) % TX_BUFFER_SIZE;
+		serialReadPos = (serialReadPos + 1) & TX_MASK;
 		} else {
 		UCSR0B &= ~(1 << UDRIE0);  // nada más que enviar
 	}
@@ -840,19 +1309,59 @@ char Chardos(void)
 		{
 			rxReadPos = 0;
 		}
+
+		// Ya se vacio lo suficiente: el host puede seguir
+		if (rx_detenido && rx_ocupado() <= RX_XON_NIVEL)
+		{
+			rx_detenido = 0;
+			enviar_flujo(XON);
+		}
 	}
 
 	return ret;
 }
+uint8_t rx_ocupado(void)
+{
+	return (uint8_t)(rxWritePos - rxReadPos) & (RX_BUFFER_SIZE - 1);
+}
+void rx_vaciar(void)
+{
+	cli();
+	rxReadPos = rxWritePos;
+	sei();
+	if (rx_detenido)
+	{
+		rx_detenido = 0;
+		enviar_flujo(XON);
+	}
+}
 ISR(USART_RX_vect)
 {
-	rxBuffer[rxWritePos] = UDR0;
+	char c = UDR0;
+
+	if (c == CANCELAR)
+	{
+		rx_cancelar = 1;
+		return;
+	}
+
+	uint8_t next = rxWritePos + 1;
+	if (next >= RX_BUFFER_SIZE)
+	{
+		next = 0;
+	}
+	if (next == rxReadPos)
+	{
+		return;   // lleno: se pierde el caracter
+	}
 
-	rxWritePos++;
+	rxBuffer[rxWritePos] = c;
+	rxWritePos = next;
 
-	if (rxWritePos >= RX_BUFFER_SIZE)
+	if (!rx_detenido && rx_ocupado() >= RX_XOFF_NIVEL)
 	{
-		rxWritePos = 0;
+		rx_detenido = 1;
+		enviar_flujo(XOFF);
 	}
 }
 
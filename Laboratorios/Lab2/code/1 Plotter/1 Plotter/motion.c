@@ -0,0 +1,299 @@
+/*
+ * motion.c
+ *
+ * Cola de pasos del plotter y salidas de direccion.
+ * Productor: lazo principal (motion_push). Consumidor: ISR del Timer1.
+ * Con un solo productor y un solo consumidor no hace falta cli() para
+ * encolar: cada lado solo modifica su propio indice.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "motion.h"
+
+
+volatile Paso     mq[MQ_SIZE];
+volatile uint8_t  mq_head = 0;      // lo escribe el lazo principal
+volatile uint8_t  mq_tail = 0;      // lo escribe la ISR
+volatile uint16_t mq_resto = 0;     // ms que le quedan al paso actual
+volatile uint8_t  mq_activo = 0;    // hay un paso ejecutandose
+
+// Paso mezclado en curso
+volatile uint8_t  mq_cmd, mq_cmd2, mq_actual;
+volatile uint16_t mq_total, mq_menor, mq_err;
+
+uint8_t motion_mezcla = 1;
+
+// Posicion real (la actualiza la ISR) y la que dejan los pasos encolados
+volatile int32_t mq_x = 0, mq_y = 0;
+int32_t mq_dest_x = 0, mq_dest_y = 0;
+
+// Avance: ms con un paso en curso y pasos sacados de la cola
+volatile uint32_t mq_ms = 0;
+volatile uint16_t mq_pasos = 0;
+
+
+void timer1_init_1ms(void) {
+	// CTC: WGM12 = 1, WGM13:0 = 0100
+	TCCR1A = 0;
+	TCCR1B = 0;
+	TCCR1B |= (1 << WGM12);
+
+	// OCR1A = F_CPU / (prescaler * 1000) - 1
+	// Con prescaler 64 y F_CPU=16 MHz -> 16000000/64/1000 - 1 = 249
+	OCR1A = (uint16_t)(F_CPU / 64UL / 1000UL - 1);
+
+	// Arrancar con prescaler = 64 (CS11=1, CS10=1)
+	TCCR1B |= (1 << CS11) | (1 << CS10);
+
+	// Limpia cualquier bandera pendiente y habilita la interrupcion de comparacion
+	TIFR1 = (1 << OCF1A);
+	TIMSK1 |= (1 << OCIE1A);
+}
+
+uint8_t motion_libre(void) {
+	return (uint8_t)(MQ_SIZE - 1 - ((mq_head - mq_tail) & MQ_MASK));
+}
+
+// Suma a (x, y) lo que mueve un comando durante ms milisegundos
+void motion_mover(uint8_t cmd, uint16_t ms, int32_t *x, int32_t *y) {
+	switch (cmd) {
+		case UP:        *y += ms; break;
+		case DOWN:      *y -= ms; break;
+		case LEFT:      *x -= ms; break;
+		case RIGHT:     *x += ms; break;
+		case UPLEFT:    *x -= ms; *y += ms; break;
+		case UPRIGHT:   *x += ms; *y += ms; break;
+		case DOWNLEFT:  *x -= ms; *y -= ms; break;
+		case DOWNRIGHT: *x += ms; *y -= ms; break;
+		default: break;              // solenoide y STOP no mueven
+	}
+}
+
+uint8_t motion_push_paso(const Paso *p) {
+	uint8_t next = (mq_head + 1) & MQ_MASK;
+	if (next == mq_tail) return 0;   // llena
+
+	// Con la cola parada el destino arranca de la posicion real
+	// (puede haber habido movimientos manuales)
+	if (!motion_ocupado()) motion_posicion(&mq_dest_x, &mq_dest_y);
+	if (p->menor) {
+		motion_mover(p->cmd, p->ms - p->menor, &mq_dest_x, &mq_dest_y);
+		motion_mover(p->cmd2, p->menor, &mq_dest_x, &mq_dest_y);
+	}
+	else {
+		motion_mover(p->cmd, p->ms, &mq_dest_x, &mq_dest_y);
+	}
+
+	mq[mq_head].cmd   = p->cmd;
+	mq[mq_head].ms    = p->ms;
+	mq[mq_head].cmd2  = p->cmd2;
+	mq[mq_head].menor = p->menor;
+	mq_head = next;
+	return 1;
+}
+
+uint8_t motion_push(uint8_t cmd, uint16_t ms) {
+	Paso p = {cmd, ms, 0, 0};
+	return motion_push_paso(&p);
+}
+
+uint8_t motion_ocupado(void) {
+	return mq_activo || (mq_head != mq_tail);
+}
+
+void motion_posicion(int32_t *x, int32_t *y) {
+	cli();
+	*x = mq_x;
+	*y = mq_y;
+	sei();
+}
+
+void motion_destino(int32_t *x, int32_t *y) {
+	if (!motion_ocupado()) {
+		motion_posicion(x, y);
+		return;
+	}
+	*x = mq_dest_x;
+	*y = mq_dest_y;
+}
+
+void motion_avance(uint32_t *ms, uint16_t *pasos) {
+	cli();
+	*ms = mq_ms;
+	*pasos = mq_pasos;
+	sei();
+}
+
+uint8_t motion_pluma(void) {
+	return (PORTD & 0b00000100) != 0;
+}
+
+void motion_origen(void) {
+	cli();
+	mq_x = mq_y = 0;
+	mq_dest_x = mq_dest_y = 0;
+	sei();
+}
+
+void motion_abort(void) {
+	cli();
+	mq_head = mq_tail;
+	mq_resto = 0;
+	mq_menor = 0;
+	mq_activo = 0;
+	apagar();
+	sei();
+}
+
+void motion_aplicar(uint8_t cmd) {
+	switch (cmd) {
+		case UP:            Subir(); break;
+		case DOWN:          Bajar(); break;
+		case LEFT:          Izquierda(); break;
+		case RIGHT:         Derecha(); break;
+
+		case UPLEFT:        ArribaIzquierda(); break;
+		case UPRIGHT:       ArribaDerecha(); break;
+		case DOWNLEFT:      AbajoIzquierda(); break;
+		case DOWNRIGHT:     AbajoDerecha(); break;
+
+		case SOLENOID_UP:   apagar(); break;
+		case SOLENOID_DOWN: Subir_s(); break;
+		case STOP:          apagar2(); break;
+
+		default:            apagar(); break;
+	}
+}
+
+
+// Elige la salida de este milisegundo en un paso mezclado
+static void motion_mezclar(void) {
+	uint8_t c = mq_cmd;
+
+	// err += menor; si llega a total, toca cmd2 (escrito para no desbordar)
+	if (mq_err >= mq_total - mq_menor) {
+		mq_err -= mq_total - mq_menor;
+		c = mq_cmd2;
+	}
+	else {
+		mq_err += mq_menor;
+	}
+	if (c != mq_actual) {
+		motion_aplicar(c);
+		mq_actual = c;
+	}
+}
+
+// Cuenta el milisegundo que termina segun los motores encendidos
+static inline void motion_contar(void) {
+	uint8_t m = PORTD;
+	if (m & 0b10000000) mq_x++;      // derecha
+	if (m & 0b01000000) mq_x--;      // izquierda
+	if (m & 0b00100000) mq_y++;      // arriba
+	if (m & 0b00010000) mq_y--;      // abajo
+}
+
+// Cada 1 ms: descuenta el paso actual y, al terminar, aplica el siguiente.
+// Los pasos de 0 ms (solenoide) se aplican juntos con el que les sigue.
+ISR(TIMER1_COMPA_vect) {
+	motion_contar();
+	if (mq_resto) mq_ms++;           // el ms que termina era de un paso
+
+	if (mq_resto > 1) {
+		mq_resto--;
+		if (mq_menor) motion_mezclar();
+		return;
+	}
+	mq_resto = 0;
+
+	while (mq_tail != mq_head) {
+		uint8_t i = mq_tail;
+		mq_resto = mq[i].ms;
+		mq_menor = mq[i].menor;
+		mq_tail = (i + 1) & MQ_MASK;
+		mq_activo = 1;
+		mq_pasos++;
+
+		if (mq_menor && mq_resto) {
+			mq_cmd   = mq[i].cmd;
+			mq_cmd2  = mq[i].cmd2;
+			mq_total = mq_resto;
+			mq_err   = mq_resto / 2;     // centrado: reparte parejo desde el principio
+			mq_actual = 0;
+			motion_mezclar();
+			return;
+		}
+		mq_menor = 0;
+		motion_aplicar(mq[i].cmd);
+		if (mq_resto) return;
+	}
+
+	// Cola vacia: se frenan los motores (el lapiz queda como estaba)
+	if (mq_activo) {
+		apagar2();
+		mq_activo = 0;
+	}
+}
+
+
+// ------------------------------------------------------------------
+// Salidas de direccion
+// ------------------------------------------------------------------
+
+void apagar(void){
+
+PORTD = (PORTD & 0b00000011) | 0b00001000;
+
+}
+
+void apagar2(void){
+
+	PORTD = (PORTD & 0b00001111) | 0b00000000;
+
+}
+void Subir_s(void)
+{
+PORTD = (PORTD & 0b00000011) | 0b00000100;
+
+
+}
+
+void Bajar(void)
+{
+PORTD = (PORTD & 0b00001111) | 0b00010000;
+}
+
+void Subir(void)
+{
+PORTD = (PORTD & 0b00001111) | 0b00100000;
+}
+
+void Izquierda(void)
+{
+PORTD = (PORTD & 0b00001111) | 0b01000000;
+}
+
+
+void Derecha(void)
+{
+PORTD = (PORTD & 0b00001111) | 0b10000000;
+}
+
+void AbajoIzquierda(void)
+{
+	PORTD = (PORTD & 0b00001111) | 0b01010000; // D6 y D4
+}
+
+void AbajoDerecha(void){
+	PORTD = (PORTD & 0b00001111) | 0b10010000; // D6 y D4
+}
+
+void ArribaIzquierda(void)
+{
+	PORTD = (PORTD & 0b00001111) | 0b01100000; // D3 y D4
+}
+
+void ArribaDerecha(void){
+	PORTD = (PORTD & 0b00001111) | 0b10100000; // D6 y D4
+}
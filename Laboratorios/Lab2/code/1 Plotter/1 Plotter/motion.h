@@ -0,0 +1,70 @@
+/*
+ * motion.h
+ *
+ * Cola de pasos temporizados del plotter.
+ * El Timer1 (CTC, 1 ms) saca los pasos de la cola y escribe PORTD desde
+ * la interrupcion; el lazo principal solo se encarga de rellenarla, asi
+ * que nunca queda bloqueado durante un dibujo.
+ */
+
+
+#ifndef MOTION_H_
+#define MOTION_H_
+
+#include <stdint.h>
+
+#define MQ_SIZE 16                 // Cantidad de pasos en cola (potencia de 2)
+#define MQ_MASK (MQ_SIZE - 1)
+
+// Paso temporizado: comando de direccion/solenoide y su duracion.
+// STOP apaga los motores manteniendo el solenoide (sirve de pausa).
+// Paso mezclado (menor > 0): durante los ms del paso la ISR reparte cada
+// milisegundo entre cmd y cmd2, dando cmd2 en exactamente 'menor' de ellos
+// (PWM por software con acumulacion de error). Asi una pendiente 1:2 es un
+// solo movimiento continuo en lugar de pasos alternados.
+typedef struct {
+	uint8_t  cmd;
+	uint16_t ms;
+	uint8_t  cmd2;
+	uint16_t menor;
+} Paso;
+
+extern uint8_t motion_mezcla;                  // 1 = generar pasos mezclados
+
+// Posicion por navegacion a estima, en ms de motor por eje (x a la
+// derecha, y hacia arriba). La ISR cuenta cada ms que un motor queda
+// encendido, asi que tambien entran los movimientos manuales.
+// El destino es donde va a quedar el lapiz cuando se vacie la cola.
+void motion_posicion(int32_t *x, int32_t *y);  // posicion real
+void motion_destino(int32_t *x, int32_t *y);   // al terminar lo encolado
+void motion_origen(void);                      // la posicion actual pasa a ser (0, 0)
+void motion_mover(uint8_t cmd, uint16_t ms, int32_t *x, int32_t *y);  // suma a (x, y) lo que mueve cmd
+
+// Avance de la cola: ms de pasos ya ejecutados y cantidad de pasos sacados
+// (los dos solo crecen; el que informa guarda el valor al empezar y resta)
+void motion_avance(uint32_t *ms, uint16_t *pasos);
+uint8_t motion_pluma(void);                    // 1 = lapiz abajo
+
+void timer1_init_1ms(void);
+
+uint8_t motion_libre(void);                    // lugares libres en la cola
+uint8_t motion_push(uint8_t cmd, uint16_t ms); // 0 si la cola esta llena
+uint8_t motion_push_paso(const Paso *p);       // igual, con mezcla
+uint8_t motion_ocupado(void);                  // 1 mientras haya pasos pendientes
+void motion_abort(void);                       // vacia la cola y levanta el lapiz
+void motion_aplicar(uint8_t cmd);              // escribe el comando en PORTD
+
+// Salidas de direccion (PORTD)
+void apagar(void);
+void apagar2(void);
+void Subir_s(void);
+void Bajar(void);
+void Subir(void);
+void Izquierda(void);
+void Derecha(void);
+void AbajoIzquierda(void);
+void AbajoDerecha(void);
+void ArribaIzquierda(void);
+void ArribaDerecha(void);
+
+#endif /* MOTION_H_ */
@@ -0,0 +1,162 @@
+/*
+ * telem.c
+ *
+ * Telemetria de avance (ver telem.h).
+ * Los informes se cuentan en tiempo de dibujo (ms de pasos ejecutados),
+ * no en tiempo de reloj: si la cola se queda sin pasos el avance no
+ * cambia y tampoco hace falta informarlo.
+ */
+
+#include <avr/pgmspace.h>
+#include "telem.h"
+#include "motion.h"
+#include "../../comun/formato.h"
+
+
+// Definidas en main.c
+void serialWrite(const char *c);
+void serialWrite_P(const char *s);
+void serialWrite_n(const char *d, uint8_t n);
+uint8_t tx_libre(void);
+
+
+static uint8_t  tl_activa = 0;
+static uint8_t  tl_periodo = TELEM_PERIODO;   // s, 0 = apagada
+static uint8_t  tl_binaria = 0;
+static uint8_t  tl_final = 0;                 // falta mandar el informe del final
+static uint8_t  tl_estimando = 0;             // tl_total todavia no esta completo
+static uint32_t tl_total;                     // ms estimados de la tarea
+static uint32_t tl_ms0;                       // avance de la cola al arrancar
+static uint16_t tl_pasos0;
+static uint32_t tl_proximo;                   // ms de la tarea del proximo informe
+
+
+// Copia un texto en flash; devuelve el final
+static char *tl_copiar(char *d, const char *s) {
+	char c;
+	while ((c = pgm_read_byte(s++)) != '\0') *d++ = c;
+	return d;
+}
+
+
+// Arma y escribe un informe. Devuelve 0 si no entro en el buffer
+static uint8_t tl_informar(uint32_t hecho, uint16_t pasos) {
+	uint32_t faltan = (hecho < tl_total) ? tl_total - hecho : 0;
+	uint16_t seg = (uint16_t)fmt_div_pot10(faltan + 999, 3);   // redondeado para arriba
+	uint8_t  pct = fmt_porciento(hecho, tl_total);
+	uint8_t  abajo = motion_pluma();
+
+	if (tl_binaria) {
+		char b[8];
+		b[0] = (char)TELEM_SYNC;
+		b[1] = (char)(pasos & 0xFF);
+		b[2] = (char)(pasos >> 8);
+		b[3] = (char)pct;
+		b[4] = (char)(seg & 0xFF);
+		b[5] = (char)(seg >> 8);
+		b[6] = (char)abajo;
+		b[7] = 0;
+		for (uint8_t i = 1; i < 7; i++) b[7] += b[i];
+
+		if (tx_libre() < sizeof(b)) return 0;
+		serialWrite_n(b, sizeof(b));
+		return 1;
+	}
+
+	char l[TELEM_TEXTO_MAX];
+	char *d = tl_copiar(l, PSTR("Avance: paso "));
+	d = fmt_u32(d, pasos);
+	d = tl_copiar(d, PSTR(", "));
+	d = fmt_u32(d, pct);
+	d = tl_copiar(d, PSTR(" %, faltan "));
+	d = fmt_mmss(d, seg);
+	d = tl_copiar(d, abajo ? PSTR(", lapiz abajo\n") : PSTR(", lapiz arriba\n"));
+	*d = '\0';
+
+	if (tx_libre() < (uint8_t)(d - l)) return 0;
+	serialWrite(l);
+	return 1;
+}
+
+// Avance de la tarea: ms y pasos desde que arranco
+static void tl_avance(uint32_t *hecho, uint16_t *pasos) {
+	motion_avance(hecho, pasos);
+	*hecho -= tl_ms0;
+	*pasos -= tl_pasos0;
+}
+
+void telem_iniciar(void) {
+	motion_avance(&tl_ms0, &tl_pasos0);
+	tl_total = 0;
+	tl_estimando = 1;
+	tl_proximo = 0;              // el primero sale cuando este el total estimado
+	tl_final = 0;
+	tl_activa = 1;
+}
+
+void telem_sumar(uint32_t ms) {
+	tl_total += ms;
+}
+
+void telem_total_listo(uint8_t listo) {
+	tl_estimando = !listo;
+}
+
+uint8_t telem_periodo(void) {
+	return tl_periodo;
+}
+
+void telem_servicio(void) {
+	uint32_t hecho;
+	uint16_t pasos;
+
+	if (!(tl_activa || tl_final) || tl_periodo == 0) return;
+	if (tl_activa && tl_estimando) return;       // sin el total no hay ETA
+
+	tl_avance(&hecho, &pasos);
+	if (tl_activa && hecho < tl_proximo) return;
+
+	if (tl_informar(hecho, pasos)) {
+		tl_proximo = hecho + (uint32_t)tl_periodo * 1000;
+		tl_final = 0;
+	}
+}
+
+// El informe del final sale en el proximo telem_servicio (o en los
+// siguientes, si el buffer esta lleno): no se puede perder
+void telem_terminar(void) {
+	uint32_t hecho;
+	uint16_t pasos;
+
+	if (!tl_activa) return;
+	tl_avance(&hecho, &pasos);
+	tl_total = hecho;            // termino: 100 % aunque la estimacion no fuera exacta
+	tl_activa = 0;
+	tl_final = 1;
+}
+
+void telem_parar(void) {
+	tl_activa = 0;
+	tl_final = 0;
+}
+
+uint8_t telem_activa(void) {
+	return tl_activa;
+}
+
+void telem_tecla(char c) {
+	if (c >= '0' && c <= '9') tl_periodo = c - '0';
+	else if (c == 'b') tl_binaria = 1;
+	else if (c == 'a') tl_binaria = 0;
+	else if (c != '\n' && c != '\r') {
+		serialWrite_P(PSTR("?\n"));
+		return;
+	}
+
+	if (tl_periodo == 0) {
+		serialWrite_P(PSTR("Telemetria: apagada\n"));
+		return;
+	}
+	fmt_printf_P(PSTR("Telemetria: cada %u s, %S\n"), tl_periodo,
+	             tl_binaria ? PSTR("binaria") : PSTR("texto"));
+}
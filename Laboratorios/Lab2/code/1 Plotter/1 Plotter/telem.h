@@ -0,0 +1,42 @@
+/*
+ * telem.h
+ *
+ * Telemetria de avance de las tareas del plotter (figura, secuencia o
+ * lista de trabajos). Al arrancar la tarea main.c estima cuanto va a
+ * tardar, de a poco en el lazo principal, y va sumando el total; cuando
+ * lo completa, cada cierto tiempo de dibujo, se informa el paso, el
+ * porcentaje hecho, lo que falta y el estado del lapiz.
+ * El avance lo cuenta la ISR del Timer1 (un contador por ms), y el
+ * informe se arma en el lazo principal y solo se escribe si entra en el
+ * buffer de transmision: si no entra se intenta en la vuelta siguiente,
+ * asi que nunca se espera a la UART ni se atrasa la cola de pasos.
+ *
+ * Texto:   "Avance: paso 1234, 45 %, faltan 5:12, lapiz abajo"
+ * Binario: 8 bytes
+ *   [0xA5] [paso L] [paso H] [%] [faltan L] [faltan H] [lapiz] [suma]
+ *   paso y faltan (en s) en little endian, lapiz 1 = abajo, suma = suma
+ *   de los bytes 1 a 6 (mod 256). En binario el host no tiene que tomar
+ *   0x11/0x13 como XON/XOFF.
+ */
+
+
+#ifndef TELEM_H_
+#define TELEM_H_
+
+#include <stdint.h>
+
+#define TELEM_SYNC         0xA5
+#define TELEM_PERIODO      5       // s entre informes al arrancar (0 = apagada)
+#define TELEM_TEXTO_MAX    64      // largo maximo del informe de texto
+
+void telem_iniciar(void);                // arranca una tarea; el total se suma despues
+void telem_sumar(uint32_t ms);           // ms estimados de otro tramo de la tarea
+void telem_total_listo(uint8_t listo);   // 1 = total completo, 0 = se esta estimando
+uint8_t telem_periodo(void);             // s entre informes, 0 = apagada
+void telem_servicio(void);               // en el lazo principal: informa si toca
+void telem_terminar(void);               // fin de la tarea: ultimo informe (100 %)
+void telem_parar(void);                  // tarea abortada: sin informe
+uint8_t telem_activa(void);              // hay una tarea en curso
+void telem_tecla(char c);                // '0'..'9' = s entre informes, 'b' binario, 'a' texto
+
+#endif /* TELEM_H_ */
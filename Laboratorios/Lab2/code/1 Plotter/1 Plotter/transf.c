@@ -0,0 +1,121 @@
+/*
+ * transf.c
+ *
+ * Transformacion afin de figuras (ver transf.h).
+ * Matriz: R(angulo) * escala * espejo, en Q12. Con escala <= 400 % los
+ * coeficientes entran en int16 y a*dx + b*dy con |dx|, |dy| <= 65535
+ * entra en int32, asi que alcanza con multiplicaciones de 32 bits.
+ * Cada paso transformado es una recta corta; lo que el motor de lineas
+ * redondea al cuantizarla tambien vuelve al pendiente y se dibuja con la
+ * recta siguiente.
+ */
+
+#include "transf.h"
+
+
+void transf_config(Transf *t, int16_t escala, int16_t angulo, uint8_t espejo) {
+	if (escala < TRANSF_ESCALA_MIN) escala = TRANSF_ESCALA_MIN;
+	if (escala > TRANSF_ESCALA_MAX) escala = TRANSF_ESCALA_MAX;
+	angulo %= 360;
+	if (angulo < 0) angulo += 360;
+
+	int32_t co = ((int32_t)coseno_q14(angulo) * escala / 100 + 2) >> 2;
+	int32_t se = ((int32_t)seno_q14(angulo) * escala / 100 + 2) >> 2;
+	int16_t m  = espejo ? -1 : 1;
+
+	t->a = (int16_t)(co * m);
+	t->b = (int16_t)(-se);
+	t->c = (int16_t)(se * m);
+	t->d = (int16_t)co;
+	t->escala = escala;
+	t->angulo = angulo;
+	t->espejo = espejo;
+	t->identidad = (t->a == TRANSF_UNO && t->b == 0 && t->c == 0 && t->d == TRANSF_UNO);
+	transf_reiniciar(t);
+}
+
+void transf_reiniciar(Transf *t) {
+	t->ex = t->ey = 0;
+	t->fx = t->fy = 0;
+	t->rx = t->ry = 0;
+	t->nuevo = 0;
+	linea_init(&t->l, 0, 0);
+}
+
+// Suma a (dx, dy) lo que mueve cmd durante ms. Devuelve 0 si no es un movimiento
+static uint8_t transf_sumar(uint8_t cmd, int32_t ms, int32_t *dx, int32_t *dy) {
+	switch (cmd) {
+		case UP:        *dy += ms; break;
+		case DOWN:      *dy -= ms; break;
+		case LEFT:      *dx -= ms; break;
+		case RIGHT:     *dx += ms; break;
+		case UPLEFT:    *dx -= ms; *dy += ms; break;
+		case UPRIGHT:   *dx += ms; *dy += ms; break;
+		case DOWNLEFT:  *dx -= ms; *dy -= ms; break;
+		case DOWNRIGHT: *dx += ms; *dy -= ms; break;
+		default: return 0;
+	}
+	return 1;
+}
+
+uint8_t transf_meter(Transf *t, const Paso *p) {
+	int32_t dx = 0, dy = 0;
+
+	if (p->menor) {
+		if (!transf_sumar(p->cmd, (int32_t)p->ms - p->menor, &dx, &dy)) return 0;
+		transf_sumar(p->cmd2, p->menor, &dx, &dy);
+	}
+	else if (!transf_sumar(p->cmd, p->ms, &dx, &dy)) {
+		return 0;
+	}
+
+	// Redondeo hacia abajo; el resto (0..4095) queda para el proximo paso
+	int32_t x = (int32_t)t->a * dx + (int32_t)t->b * dy + t->ex;
+	int32_t y = (int32_t)t->c * dx + (int32_t)t->d * dy + t->ey;
+	t->ex = x & (TRANSF_UNO - 1);
+	t->ey = y & (TRANSF_UNO - 1);
+	t->fx += x >> 12;
+	t->fy += y >> 12;
+	t->nuevo = 1;
+	return 1;
+}
+
+void transf_cerrar(Transf *t) {
+	t->nuevo = 2;
+}
+
+uint8_t transf_sacar(Transf *t, Paso *p) {
+	for (;;) {
+		if (linea_paso(&t->l, p)) {
+			int32_t dx = 0, dy = 0;
+			transf_sumar(p->cmd, (int32_t)p->ms - p->menor, &dx, &dy);
+			if (p->menor) transf_sumar(p->cmd2, p->menor, &dx, &dy);
+			t->rx -= dx;
+			t->ry -= dy;
+			return 1;
+		}
+
+		// Termino la recta: lo que no se llego a hacer vuelve al pendiente
+		t->fx += t->rx;
+		t->fy += t->ry;
+		t->rx = t->ry = 0;
+		if (t->nuevo == 0 || (t->fx == 0 && t->fy == 0)) return 0;
+
+		// Desplazamientos largos (escala > 100 %) se dibujan en varias rectas
+		int32_t ax = (t->fx < 0) ? -t->fx : t->fx;
+		int32_t ay = (t->fy < 0) ? -t->fy : t->fy;
+		int32_t m  = (ax > ay) ? ax : ay;
+		int32_t px = t->fx, py = t->fy;
+		if (m > TRANSF_TRAMO_MAX) {
+			int32_t k = m / TRANSF_TRAMO_MAX + 1;
+			px /= k;
+			py /= k;
+		}
+		t->fx -= px;
+		t->fy -= py;
+		t->rx = px;
+		t->ry = py;
+		if (t->nuevo == 1 && t->fx == 0 && t->fy == 0) t->nuevo = 0;
+		linea_init(&t->l, (int16_t)px, (int16_t)py);
+	}
+}
@@ -0,0 +1,45 @@
+/*
+ * transf.h
+ *
+ * Transformacion afin de las figuras (escala, giro y espejo).
+ * Se ubica entre la lectura de la figura y la cola de pasos: cada paso
+ * se pasa a su desplazamiento (dx, dy), se multiplica por una matriz en
+ * punto fijo Q12 y el resultado se vuelve a dibujar con el motor de
+ * lineas, que lo reparte en las 8 direcciones. Lo que se pierde al
+ * redondear cada paso se arrastra al siguiente (difusion de error), asi
+ * que la figura completa no acumula corrimiento.
+ */
+
+
+#ifndef TRANSF_H_
+#define TRANSF_H_
+
+#include <stdint.h>
+#include "motion.h"
+#include "trazo.h"
+
+#define TRANSF_UNO        4096     // 1.0 en Q12
+#define TRANSF_ESCALA_MIN 10       // %
+#define TRANSF_ESCALA_MAX 400      // con 400 % la matriz todavia entra en int16
+#define TRANSF_TRAMO_MAX  30000    // ms por recta (linea_init usa int16)
+
+typedef struct {
+	int16_t a, b, c, d;     // x' = a x + b y,  y' = c x + d y  (Q12)
+	int16_t escala;         // %
+	int16_t angulo;         // grados, antihorario
+	uint8_t espejo;         // 1 = se invierte x antes de girar
+	uint8_t identidad;      // no hay que transformar nada
+	int32_t ex, ey;         // resto del redondeo (Q12), pasa al paso siguiente
+	int32_t fx, fy;         // desplazamiento ya transformado que falta dibujar (ms)
+	int32_t rx, ry;         // lo que falta de la recta en curso
+	uint8_t nuevo;          // 1 = entro un paso, 2 = fin de figura: dibujar todo lo pendiente
+	Linea   l;
+} Transf;
+
+void transf_config(Transf *t, int16_t escala, int16_t angulo, uint8_t espejo);
+void transf_reiniciar(Transf *t);                 // al empezar cada figura
+uint8_t transf_meter(Transf *t, const Paso *p);   // 0 si el paso no mueve (solenoide, STOP)
+uint8_t transf_sacar(Transf *t, Paso *p);         // proximo paso transformado, 0 si no hay
+void transf_cerrar(Transf *t);                    // fin de figura: sacar tambien los restos
+
+#endif /* TRANSF_H_ */
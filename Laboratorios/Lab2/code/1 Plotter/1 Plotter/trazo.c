@@ -0,0 +1,264 @@
+/*
+ * trazo.c
+ *
+ * Motor de lineas (Bresenham por tiempo).
+ * El eje mayor avanza de a LINEA_CUANTO_MS; en cada cuanto se decide si
+ * el eje menor tambien avanza (paso diagonal) segun el error acumulado.
+ * Los arcos caminan sobre una grilla de cuantos eligiendo en cada paso
+ * entre el eje dominante de la tangente y la diagonal, el que deje menor
+ * error radial (punto medio). Todo con enteros: no se usa punto flotante.
+ */
+
+#include <avr/pgmspace.h>
+#include "trazo.h"
+
+
+// sen(0..90 grados) * 16384
+const uint16_t SENO_Q14[91] PROGMEM = {
+	    0,   286,   572,   857,  1143,  1428,  1713,  1997,  2280,  2563,
+	 2845,  3126,  3406,  3686,  3964,  4240,  4516,  4790,  5063,  5334,
+	 5604,  5872,  6138,  6402,  6664,  6924,  7182,  7438,  7692,  7943,
+	 8192,  8438,  8682,  8923,  9162,  9397,  9630,  9860, 10087, 10311,
+	10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+	12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+	14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+	15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+	16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+	16384
+};
+
+int16_t seno_q14(int16_t grados) {
+	grados %= 360;
+	if (grados < 0) grados += 360;
+
+	uint8_t neg = 0;
+	if (grados >= 180) {
+		grados -= 180;
+		neg = 1;
+	}
+	if (grados > 90) grados = 180 - grados;
+
+	int16_t v = (int16_t)pgm_read_word(&SENO_Q14[grados]);
+	return neg ? -v : v;
+}
+
+int16_t coseno_q14(int16_t grados) {
+	return seno_q14(grados + 90);
+}
+
+// Comando para un movimiento de un cuanto en (sx, sy), cada uno -1, 0 o 1
+static uint8_t trazo_comando(int8_t sx, int8_t sy) {
+	if (sy > 0) return (sx > 0) ? UPRIGHT : (sx < 0) ? UPLEFT : UP;
+	if (sy < 0) return (sx > 0) ? DOWNRIGHT : (sx < 0) ? DOWNLEFT : DOWN;
+	return (sx > 0) ? RIGHT : LEFT;
+}
+
+// Entrega el proximo paso juntando cuantos iguales seguidos.
+// pend guarda el cuanto ya calculado que no se pudo juntar.
+static uint8_t trazo_juntar(void *g, uint8_t (*cuanto)(void *, Paso *), Paso *pend, Paso *p) {
+	Paso q = {0, 0, 0, 0};
+
+	if (pend->ms == 0 && !cuanto(g, pend)) return 0;
+
+	*p = *pend;
+	pend->ms = 0;
+
+	while (cuanto(g, &q)) {
+		if (q.cmd != p->cmd || (uint32_t)p->ms + q.ms > 0xFFFF) {
+			*pend = q;
+			break;
+		}
+		p->ms += q.ms;
+	}
+	return 1;
+}
+
+
+void linea_init(Linea *l, int16_t dx, int16_t dy) {
+	uint16_t ax = (dx < 0) ? -dx : dx;
+	uint16_t ay = (dy < 0) ? -dy : dy;
+	uint8_t  h  = (dx < 0) ? LEFT : RIGHT;
+	uint8_t  v  = (dy < 0) ? DOWN : UP;
+
+	if (dy < 0) l->diag = (dx < 0) ? DOWNLEFT : DOWNRIGHT;
+	else        l->diag = (dx < 0) ? UPLEFT : UPRIGHT;
+
+	if (ax >= ay) {
+		l->mayor = ax;
+		l->menor = ay;
+		l->recto = h;
+	}
+	else {
+		l->mayor = ay;
+		l->menor = ax;
+		l->recto = v;
+	}
+
+	l->resto = l->mayor;
+	l->err = 0;
+	l->pend = (Paso){0, 0, 0, 0};
+}
+
+// Calcula el proximo cuanto del segmento. Devuelve 0 si no queda nada
+static uint8_t linea_cuanto(void *g, Paso *q) {
+	Linea *l = (Linea *)g;
+
+	if (l->resto == 0) return 0;
+
+	uint16_t t = (l->resto < LINEA_CUANTO_MS) ? l->resto : LINEA_CUANTO_MS;
+	l->resto -= t;
+
+	// Segmentos rectos o a 45 grados: un solo paso con todo el tiempo
+	if (l->menor == 0 || l->menor == l->mayor) {
+		t += l->resto;
+		l->resto = 0;
+	}
+
+	int32_t e = l->err + (int32_t)t * l->menor;
+	if (2 * e >= (int32_t)t * l->mayor) {
+		q->cmd = l->diag;
+		e -= (int32_t)t * l->mayor;
+	}
+	else {
+		q->cmd = l->recto;
+	}
+	l->err = e;
+	q->ms = t;
+	return 1;
+}
+
+// Devuelve el proximo paso del segmento, juntando cuantos iguales seguidos.
+// Con motion_mezcla, un segmento de pendiente intermedia sale entero como
+// un solo paso mezclado: la ISR reparte recto/diagonal de a 1 ms.
+uint8_t linea_paso(Linea *l, Paso *p) {
+	if (motion_mezcla && l->resto == l->mayor && l->menor != 0 && l->menor != l->mayor) {
+		p->cmd   = l->recto;
+		p->cmd2  = l->diag;
+		p->ms    = l->mayor;
+		p->menor = l->menor;
+		l->resto = 0;
+		return 1;
+	}
+	return trazo_juntar(l, linea_cuanto, &l->pend, p);
+}
+
+
+// Division redondeada al entero mas cercano (d > 0)
+static int16_t div_red(int16_t n, uint8_t d) {
+	return (n >= 0) ? (n + d / 2) / d : -((-n + d / 2) / d);
+}
+
+void arco_init(Arco *a, int16_t sx, int16_t sy, int16_t ex, int16_t ey, uint8_t horario) {
+	uint16_t ax = (sx < 0) ? -sx : sx;
+	uint16_t ay = (sy < 0) ? -sy : sy;
+	uint16_t r  = (ax > ay) ? ax : ay;
+	uint16_t c  = r / ARCO_DIV;
+
+	if (c > LINEA_CUANTO_MS) c = LINEA_CUANTO_MS;
+	if (c == 0) c = 1;
+
+	// Horario = antihorario con el eje y espejado
+	if (horario) {
+		sy = -sy;
+		ey = -ey;
+	}
+
+	a->cuanto  = c;
+	a->horario = horario;
+	a->x  = div_red(sx, c);
+	a->y  = div_red(sy, c);
+	a->x0 = a->x;
+	a->y0 = a->y;
+	a->ex = ex;
+	a->ey = ey;
+	a->f  = 0;                // el radio es el del punto inicial
+	a->fin = (a->x == 0 && a->y == 0);
+	a->pend = (Paso){0, 0, 0, 0};
+
+	// Si el punto final esta por delante a menos de media vuelta ya se
+	// puede cortar al cruzarlo; si no, hay que pasar antes por detras.
+	// Se usan los valores en ms (a la mitad para no desbordar): con el
+	// punto final igual al inicial da 0 y sale el circulo completo
+	int32_t cruz = (int32_t)(ex >> 1) * (sy >> 1) - (int32_t)(ey >> 1) * (sx >> 1);
+	a->armado = (cruz < 0);
+}
+
+void arco_polar(Arco *a, int16_t r, int16_t a0, int16_t barrido) {
+	int16_t a1 = a0 + barrido;
+
+	arco_init(a,
+		(int16_t)(((int32_t)r * coseno_q14(a0) + 8192) >> 14),
+		(int16_t)(((int32_t)r * seno_q14(a0) + 8192) >> 14),
+		coseno_q14(a1), seno_q14(a1),
+		barrido < 0);
+
+	// Con los angulos se sabe el barrido exacto, sin errores de la tabla
+	if (barrido < 0) barrido = -barrido;
+	a->armado = (barrido < 180);
+}
+
+// Avanza un cuanto sobre el arco (siempre antihorario en la grilla)
+static uint8_t arco_cuanto(void *g, Paso *q) {
+	Arco *a = (Arco *)g;
+
+	if (a->fin) return 0;
+
+	int16_t x = a->x;
+	int16_t y = a->y;
+
+	// Sentido de avance en cada eje segun la tangente (-y, x)
+	int8_t sx = (y > 0) ? -1 : (y < 0) ? 1 : (x > 0) ? -1 : 1;
+	int8_t sy = (x > 0) ? 1 : (x < 0) ? -1 : (y > 0) ? -1 : 1;
+
+	// Candidatos: solo el eje dominante de la tangente o la diagonal
+	int8_t mx = sx, my = sy;
+	int32_t fd = a->f + (int32_t)sx * (2 * x + sx) + (int32_t)sy * (2 * y + sy);
+	int32_t fr;
+	if ((x < 0 ? -x : x) >= (y < 0 ? -y : y)) {
+		mx = 0;
+		fr = a->f + (int32_t)sy * (2 * y + sy);
+	}
+	else {
+		my = 0;
+		fr = a->f + (int32_t)sx * (2 * x + sx);
+	}
+
+	if ((fd < 0 ? -fd : fd) < (fr < 0 ? -fr : fr)) {
+		mx = sx;
+		my = sy;
+		a->f = fd;
+	}
+	else {
+		a->f = fr;
+	}
+
+	a->x = x + mx;
+	a->y = y + my;
+
+	// Corte al cruzar la direccion del punto final
+	int32_t cruz = (int32_t)a->ex * a->y - (int32_t)a->ey * a->x;
+	int32_t prod = (int32_t)a->ex * a->x + (int32_t)a->ey * a->y;
+	if (!a->armado) {
+		if (cruz < 0) a->armado = 1;
+	}
+	else if (cruz >= 0 && prod > 0) {
+		a->fin = 1;
+	}
+
+	q->cmd = trazo_comando(mx, a->horario ? -my : my);
+	q->ms = a->cuanto;
+	return 1;
+}
+
+uint8_t arco_paso(Arco *a, Paso *p) {
+	return trazo_juntar(a, arco_cuanto, &a->pend, p);
+}
+
+// Lo que se movio el lapiz desde el inicio del arco. Como el arco corta
+// al cruzar la direccion final, sirve para corregir hasta el punto exacto
+void arco_recorrido(const Arco *a, int16_t *dx, int16_t *dy) {
+	int16_t my = (a->y - a->y0) * a->cuanto;
+
+	*dx = (a->x - a->x0) * a->cuanto;
+	*dy = a->horario ? -my : my;
+}
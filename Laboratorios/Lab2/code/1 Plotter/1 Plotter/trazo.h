@@ -0,0 +1,79 @@
+/*
+ * trazo.h
+ *
+ * Interpolacion de segmentos rectos para el plotter.
+ * Un segmento (dx, dy) en unidades de tiempo del plotter (ms de motor
+ * encendido por eje) se convierte en una mezcla de pasos rectos y
+ * diagonales usando acumulacion de error entera (Bresenham).
+ * Los arcos se recorren con un algoritmo de punto medio (circulo de
+ * Bresenham) sobre una grilla de cuantos, tambien solo con enteros.
+ * Los cuantos consecutivos con el mismo comando se juntan en un solo paso;
+ * con motion_mezcla las rectas salen como un unico paso mezclado.
+ */
+
+
+#ifndef TRAZO_H_
+#define TRAZO_H_
+
+#include <stdint.h>
+#include "motion.h"
+
+#define LINEA_CUANTO_MS 50         // resolucion de la interpolacion
+#define ARCO_DIV        32         // el cuanto de un arco es radio / ARCO_DIV (max LINEA_CUANTO_MS)
+
+// Figuras vectoriales: lista de Tramo en flash terminada en TR_FIN.
+//   {TR_LINEA, dx, dy}         segmento relativo
+//   {TR_ARCO, r, a0, barrido}  arco de radio r que arranca en el angulo a0
+//                              (grados, el lapiz ya esta sobre el arco);
+//                              barrido > 0 antihorario, < 0 horario,
+//                              +-360 circulo completo
+//   {SOLENOID_DOWN, ms, 0}     baja el lapiz y espera ms
+//   {SOLENOID_UP, ms, 0}       levanta el lapiz y espera ms
+//   {STOP, ms, 0}              pausa con los motores apagados
+#define TR_FIN    0
+#define TR_LINEA  12
+#define TR_ARCO   13
+
+typedef struct {
+	uint8_t op;
+	int16_t x, y;
+	int16_t z;          // solo TR_ARCO: barrido
+} Tramo;
+
+typedef struct {
+	uint16_t resto;     // ms que faltan sobre el eje mayor
+	uint16_t mayor;     // |delta| del eje mayor
+	uint16_t menor;     // |delta| del eje menor
+	int32_t  err;       // error acumulado del eje menor (escala ms * mayor)
+	uint8_t  recto;     // comando solo eje mayor
+	uint8_t  diag;      // comando diagonal
+	Paso     pend;      // cuanto ya calculado que quedo para el proximo paso
+} Linea;
+
+typedef struct {
+	int16_t  x, y;      // posicion respecto del centro, en cuantos
+	int16_t  x0, y0;    // posicion inicial, en cuantos
+	int32_t  f;         // x^2 + y^2 - r^2 (error radial)
+	int16_t  ex, ey;    // direccion del punto final respecto del centro
+	uint8_t  cuanto;    // ms por paso de la grilla
+	uint8_t  horario;   // se recorre espejado en y
+	uint8_t  armado;    // ya paso por detras del punto final
+	uint8_t  fin;
+	Paso     pend;
+} Arco;
+
+void linea_init(Linea *l, int16_t dx, int16_t dy);
+uint8_t linea_paso(Linea *l, Paso *p);   // 0 cuando el segmento termino
+
+// Posiciones inicial (sx, sy) y final (ex, ey) respecto del centro, en ms.
+// El radio lo fija el punto inicial; del final solo importa la direccion.
+// Si las dos direcciones coinciden se dibuja el circulo completo.
+void arco_init(Arco *a, int16_t sx, int16_t sy, int16_t ex, int16_t ey, uint8_t horario);
+void arco_polar(Arco *a, int16_t r, int16_t a0, int16_t barrido);
+uint8_t arco_paso(Arco *a, Paso *p);     // 0 cuando el arco termino
+void arco_recorrido(const Arco *a, int16_t *dx, int16_t *dy);   // desplazamiento hecho, en ms
+
+int16_t seno_q14(int16_t grados);        // sen(grados) * 16384
+int16_t coseno_q14(int16_t grados);
+
+#endif /* TRAZO_H_ */
@@ -0,0 +1,17 @@
+/*
+ * avr/interrupt.h (simulador)
+ *
+ * Las ISR quedan como funciones comunes que llama el reloj virtual.
+ * No hay concurrencia real, asi que cli()/sei() no hacen nada.
+ */
+
+#ifndef SIM_INTERRUPT_H_
+#define SIM_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...)  void vector(void); void vector(void)
+#define cli()             ((void)0)
+#define sei()             ((void)0)
+
+#endif /* SIM_INTERRUPT_H_ */
@@ -0,0 +1,37 @@
+/*
+ * avr/io.h (simulador)
+ *
+ * Registros del ATmega328P que usa el plotter, como variables comunes.
+ * Se definen en sim.c; el simulador lee PORTD despues de cada ms virtual.
+ */
+
+#ifndef SIM_IO_H_
+#define SIM_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit)         (1 << (bit))
+#define _SFR_BYTE(sfr)   (sfr)
+
+extern volatile uint8_t PORTB, DDRB, PORTD, DDRD;
+extern volatile uint8_t UBRR0H, UBRR0L, UCSR0A, UCSR0B, UCSR0C, UDR0;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1;
+extern volatile uint16_t OCR1A;
+
+#define PORTB0  0
+
+#define U2X0    1
+#define UDRIE0  5
+#define TXEN0   3
+#define RXEN0   4
+#define RXCIE0  7
+#define UCSZ00  1
+#define UCSZ01  2
+
+#define CS10    0
+#define CS11    1
+#define WGM12   3
+#define OCIE1A  1
+#define OCF1A   1
+
+#endif /* SIM_IO_H_ */
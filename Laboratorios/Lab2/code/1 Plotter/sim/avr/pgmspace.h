@@ -0,0 +1,22 @@
+/*
+ * avr/pgmspace.h (simulador)
+ *
+ * En la PC la flash es memoria comun: PROGMEM no hace nada y las
+ * lecturas son accesos directos.
+ */
+
+#ifndef SIM_PGMSPACE_H_
+#define SIM_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)             (s)
+#define pgm_read_byte(p)    (*(const uint8_t *)(p))
+#define pgm_read_word(p)    (*(const uint16_t *)(p))
+#define pgm_read_dword(p)   (*(const uint32_t *)(p))
+#define pgm_read_ptr(p)     (*(void * const *)(p))
+#define strlen_P            strlen
+
+#endif /* SIM_PGMSPACE_H_ */
@@ -0,0 +1,396 @@
+/*
+ * sim.c
+ *
+ * Simulador del plotter para la PC.
+ * Compila el main.c del plotter contra registros falsos (sim/avr/io.h) y
+ * un reloj virtual: cada ms se atiende el lazo principal y se llama a la
+ * ISR del Timer1, igual que en el micro. Despues de cada ms se mira PORTD
+ * para mover el lapiz, asi que el tiempo que se informa es el exacto.
+ *
+ * Uso: plotsim [-o salida.svg] [-b baudios] [-d] [-h] [-t transf] figura | -l lista | -w texto | archivo.gcode
+ *      plotsim -f   (prueba de la fuente: cada glifo tiene que dibujar algo)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Aca la ISR UDRE no corre sola: si se esperara lugar en el buffer de
+// transmision la simulacion se colgaria
+#define TX_POLITICA TX_CORTAR
+
+#define main plotter_main
+#include "main.c"
+#undef main
+
+
+volatile uint8_t PORTB, DDRB, PORTD, DDRD;
+volatile uint8_t UBRR0H, UBRR0L, UCSR0A, UCSR0B, UCSR0C, UDR0;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1;
+volatile uint16_t OCR1A;
+
+static double delay_ms = 0;     // esperas activas (_delay_ms) fuera del reloj
+
+void _delay_ms(double ms) { delay_ms += ms; }
+void _delay_us(double us) { delay_ms += us / 1000.0; }
+
+
+#define SIM_MAX_MS      (4UL * 3600UL * 1000UL)   // corta a las 4 horas virtuales
+#define SIM_VUELTAS     8                         // vueltas del lazo por ms
+
+// Bits de PORTD (ver motion.c)
+#define PD_PLUMA_ABAJO  0x04
+#define PD_ABAJO        0x10
+#define PD_ARRIBA       0x20
+#define PD_IZQUIERDA    0x40
+#define PD_DERECHA      0x80
+#define PD_MOTORES      0xF0
+
+
+// Busca una figura del catalogo de main.c por nombre (sin mayusculas)
+static int buscar_figura(const char *nombre) {
+	for (unsigned i = 0; i < CATALOGO_CANT; i++) {
+		if (!strcasecmp(CATALOGO[i].nombre, nombre)) return (int)i;
+	}
+	return -1;
+}
+
+
+// Trayectoria: un vertice cada vez que cambia la salida
+typedef struct {
+	long x, y;
+	uint8_t abajo;      // el tramo que llega a este punto se dibujo con el lapiz abajo
+} Punto;
+
+static Punto *puntos;
+static size_t n_puntos, cap_puntos;
+
+static void agregar_punto(long x, long y, uint8_t abajo) {
+	if (n_puntos == cap_puntos) {
+		cap_puntos = cap_puntos ? cap_puntos * 2 : 1024;
+		puntos = realloc(puntos, cap_puntos * sizeof(Punto));
+		if (!puntos) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	puntos[n_puntos].x = x;
+	puntos[n_puntos].y = y;
+	puntos[n_puntos].abajo = abajo;
+	n_puntos++;
+}
+
+
+// Host que manda el G-code a la velocidad de la UART y respeta XON/XOFF
+static const char *host_texto;
+static size_t host_pos, host_largo;
+static double host_credito, host_chars_ms;
+static uint8_t host_pausado;
+static int verboso;
+
+static void host_enviar(void) {
+	if (!host_texto) return;
+
+	host_credito += host_chars_ms;
+	while (host_credito >= 1.0 && host_pos < host_largo && !host_pausado) {
+		UDR0 = (uint8_t)host_texto[host_pos++];
+		USART_RX_vect();
+		host_credito -= 1.0;
+	}
+	if (host_credito > 1.0) host_credito = 1.0;
+}
+
+// Saca lo que el plotter transmite (un caracter por ms alcanza a 9600)
+static void host_recibir(void) {
+	while (UCSR0B & (1 << UDRIE0)) {
+		UDR0 = 0;
+		USART_UDRE_vect();
+		char c = (char)UDR0;
+		if (c == XOFF) host_pausado = 1;
+		else if (c == XON) host_pausado = 0;
+		else if (c && verboso) putchar(c);
+	}
+}
+
+static char *leer_archivo(const char *ruta, size_t *largo) {
+	FILE *f = fopen(ruta, "rb");
+	if (!f) {
+		perror(ruta);
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	long n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	char *buf = malloc(n + 6);
+	if (!buf || fread(buf, 1, n, f) != (size_t)n) {
+		fprintf(stderr, "%s: no se pudo leer\n", ruta);
+		exit(1);
+	}
+	fclose(f);
+
+	// M2 al final por si el archivo no lo trae (si lo trae, no se lee)
+	if (n == 0 || buf[n - 1] != '\n') buf[n++] = '\n';
+	memcpy(buf + n, "M2\n", 4);
+	n += 3;
+	*largo = n;
+	return buf;
+}
+
+static void escribir_svg(const char *ruta) {
+	long minx = 0, maxx = 0, miny = 0, maxy = 0;
+	for (size_t i = 0; i < n_puntos; i++) {
+		if (puntos[i].x < minx) minx = puntos[i].x;
+		if (puntos[i].x > maxx) maxx = puntos[i].x;
+		if (puntos[i].y < miny) miny = puntos[i].y;
+		if (puntos[i].y > maxy) maxy = puntos[i].y;
+	}
+
+	long borde = 500;
+	long ancho = maxx - minx + 2 * borde;
+	long alto  = maxy - miny + 2 * borde;
+
+	FILE *f = fopen(ruta, "w");
+	if (!f) {
+		perror(ruta);
+		exit(1);
+	}
+
+	// Unidades del SVG = ms de motor; y hacia arriba como en el plotter
+	fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%ld\" height=\"%ld\" "
+	        "viewBox=\"%ld %ld %ld %ld\">\n",
+	        ancho / 20, alto / 20, minx - borde, -maxy - borde, ancho, alto);
+	fprintf(f, "<rect x=\"%ld\" y=\"%ld\" width=\"%ld\" height=\"%ld\" fill=\"white\"/>\n",
+	        minx - borde, -maxy - borde, ancho, alto);
+
+	// Tramos con el mismo estado de lapiz en una sola polilinea
+	size_t i = 1;
+	while (i < n_puntos) {
+		uint8_t abajo = puntos[i].abajo;
+		fprintf(f, "<polyline fill=\"none\" %s points=\"%ld,%ld",
+		        abajo ? "stroke=\"black\" stroke-width=\"40\" stroke-linejoin=\"round\""
+		              : "stroke=\"#9ab\" stroke-width=\"20\" stroke-dasharray=\"100,80\"",
+		        puntos[i - 1].x, -puntos[i - 1].y);
+		while (i < n_puntos && puntos[i].abajo == abajo) {
+			fprintf(f, " %ld,%ld", puntos[i].x, -puntos[i].y);
+			i++;
+		}
+		fprintf(f, "\"/>\n");
+	}
+
+	fprintf(f, "<circle cx=\"0\" cy=\"0\" r=\"80\" fill=\"red\"/>\n");
+	fprintf(f, "</svg>\n");
+	fclose(f);
+}
+
+// Lo que se mide en una simulacion; x, y entran como punto de partida
+typedef struct {
+	unsigned long t, quieto, abajo_ms;
+	double dist_abajo, dist_arriba;
+	long x, y;
+} Medida;
+
+// Corre el reloj virtual hasta que termina el trabajo en curso
+static void simular(int volver, Medida *m) {
+	unsigned long t = 0, quieto = 0, abajo_ms = 0;
+	double dist_abajo = 0, dist_arriba = 0;
+	long x = m->x, y = m->y;
+	uint8_t ultimo = PORTD;
+
+	agregar_punto(x, y, 0);
+
+	for (;;) {
+		if (!trabajo_activo() && !gcode_activo()) {
+			if (!volver) break;
+			volver = 0;
+			trabajo_iniciar(TRABAJO_ORIGEN, 0);
+		}
+		if (t >= SIM_MAX_MS) {
+			fprintf(stderr, "se corto la simulacion a las %lu h virtuales\n", SIM_MAX_MS / 3600000UL);
+			break;
+		}
+
+		host_enviar();
+		for (uint8_t k = 0; k < SIM_VUELTAS; k++) {
+			if (gcode_activo()) gcode_servicio();
+			else {
+				progreso_servicio();
+				trabajo_cargar();
+			}
+		}
+		host_recibir();
+
+		TIMER1_COMPA_vect();
+		t++;
+
+		uint8_t pd = PORTD;
+		if (pd != ultimo) {
+			agregar_punto(x, y, (ultimo & PD_PLUMA_ABAJO) != 0);
+			ultimo = pd;
+		}
+
+		// Durante este ms los motores quedan como los dejo la ISR
+		int dx = ((pd & PD_DERECHA) ? 1 : 0) - ((pd & PD_IZQUIERDA) ? 1 : 0);
+		int dy = ((pd & PD_ARRIBA) ? 1 : 0) - ((pd & PD_ABAJO) ? 1 : 0);
+		double d = (dx && dy) ? M_SQRT2 : (dx || dy) ? 1.0 : 0.0;
+
+		if (!(pd & PD_MOTORES)) quieto++;
+		if (pd & PD_PLUMA_ABAJO) {
+			dist_abajo += d;
+			abajo_ms++;
+		}
+		else {
+			dist_arriba += d;
+		}
+		x += dx;
+		y += dy;
+	}
+	agregar_punto(x, y, (ultimo & PD_PLUMA_ABAJO) != 0);
+
+	m->t = t;
+	m->quieto = quieto;
+	m->abajo_ms = abajo_ms;
+	m->dist_abajo = dist_abajo;
+	m->dist_arriba = dist_arriba;
+	m->x = x;
+	m->y = y;
+}
+
+// Escribe cada glifo de FUENTE por separado, como con la tecla w, y
+// cuenta los que no bajan el lapiz en ningun momento
+static int probar_fuente(void) {
+	const uint8_t *g = FUENTE;
+	uint8_t codigo;
+	int glifos = 0, malos = 0;
+	Medida m = {0};
+
+	while ((codigo = pgm_read_byte(g++)) != 0) {
+		while (pgm_read_byte(g++) != FF) ;
+
+		// Como "w<glifo>" + Enter
+		texto_leyendo = 1;
+		texto_largo = 0;
+		texto_tecla((char)codigo);
+		texto_tecla('\n');
+		simular(0, &m);
+		host_recibir();
+
+		glifos++;
+		if (m.abajo_ms == 0) {
+			printf("Glifo '%c': no dibuja nada\n", codigo);
+			malos++;
+		}
+	}
+	printf("Fuente: %d glifos, %d sin dibujo\n", glifos, malos);
+	return malos ? 1 : 0;
+}
+
+static void uso(void) {
+	fprintf(stderr, "uso: plotsim [-o salida.svg] [-b baudios] [-d] [-h] [-t transf] [-v]\n"
+	                "               figura | -l lista | -w texto | archivo.gcode\n");
+	fprintf(stderr, "  -d  pasos discretos (sin mezcla de ejes)\n");
+	fprintf(stderr, "  -f  prueba de la fuente: falla si algun glifo no baja el lapiz\n");
+	fprintf(stderr, "  -h  al terminar vuelve al origen (tecla h)\n");
+	fprintf(stderr, "  -l  lista de trabajos como en la tecla k, ej: -l 124h\n");
+	fprintf(stderr, "  -t  escala/giro/espejo como en la tecla t, ej: -t \"e150 a30 m1\"\n");
+	fprintf(stderr, "  -w  texto como en la tecla w\n");
+	fprintf(stderr, "figuras: centrar");
+	for (unsigned i = 0; i < CATALOGO_CANT; i++) fprintf(stderr, " %s", CATALOGO[i].nombre);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	const char *salida = "plot.svg";
+	const char *entrada = 0;
+	const char *teclas = 0;
+	const char *transf = 0;
+	const char *escrito = 0;
+	long baudios = BAUD;
+	int volver = 0;
+	int fuente = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-o") && i + 1 < argc) salida = argv[++i];
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc) baudios = atol(argv[++i]);
+		else if (!strcmp(argv[i], "-v")) verboso = 1;
+		else if (!strcmp(argv[i], "-d")) motion_mezcla = 0;
+		else if (!strcmp(argv[i], "-h")) volver = 1;
+		else if (!strcmp(argv[i], "-f")) fuente = 1;
+		else if (!strcmp(argv[i], "-l") && i + 1 < argc) entrada = teclas = argv[++i];
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc) transf = argv[++i];
+		else if (!strcmp(argv[i], "-w") && i + 1 < argc) entrada = escrito = argv[++i];
+		else if (argv[i][0] == '-') uso();
+		else entrada = argv[i];
+	}
+	if ((!entrada && !fuente) || baudios <= 0) uso();
+
+	// Misma configuracion que main(): UART, Timer1 y puertos
+	UBRR0H = (BRC >> 8);
+	UBRR0L = BRC;
+	UCSR0A = (1 << U2X0);
+	timer1_init_1ms();
+	UCSR0B = (1 << TXEN0) | (1 << RXEN0) | (1 << RXCIE0);
+	DDRD = 0b11111110;
+	PORTD = 0;
+
+	transf_config(&trabajo_transf, 100, 0, 0);
+	if (transf) {
+		transf_aplicar(transf);
+		transf_informar();
+	}
+
+	if (fuente) return probar_fuente();
+
+	int fg = buscar_figura(entrada);
+
+	if (teclas) {
+		// Como si se escribiera "k<teclas>" + Enter en el menu
+		lista_leyendo = 1;
+		while (*teclas) lista_tecla(*teclas++);
+		lista_tecla('\n');
+	}
+	else if (escrito) {
+		// Como si se escribiera "w<texto>" + Enter en el menu
+		texto_leyendo = 1;
+		while (*escrito) texto_tecla(*escrito++);
+		texto_tecla('\n');
+	}
+	else if (!strcmp(entrada, "centrar")) {
+		centrar();
+	}
+	else if (fg >= 0) {
+		catalogo_iniciar((uint8_t)fg);
+	}
+	else {
+		host_texto = leer_archivo(entrada, &host_largo);
+		host_chars_ms = baudios / 10.0 / 1000.0;   // 8N1: 10 bits por caracter
+		gcode_iniciar();
+	}
+	host_recibir();
+
+	Medida m = {0};
+	simular(volver, &m);
+
+	// Ultimo informe de avance
+	progreso_servicio();
+	progreso_servicio();
+	host_recibir();
+
+	escribir_svg(salida);
+
+	printf("Entrada:            %s\n", entrada);
+	printf("Tiempo total:       %lu ms (%lu:%02lu)\n", m.t, m.t / 60000, (m.t / 1000) % 60);
+	printf("Lapiz abajo:        %lu ms, recorrido %.0f\n", m.abajo_ms, m.dist_abajo);
+	printf("Traslado sin dibujo: recorrido %.0f\n", m.dist_arriba);
+	printf("Motores quietos:    %lu ms (%.1f %%)\n", m.quieto, m.t ? 100.0 * m.quieto / m.t : 0.0);
+	if (delay_ms > 0) printf("Esperas activas:    %.0f ms fuera del reloj\n", delay_ms);
+	printf("Cambios de salida:  %zu\n", n_puntos - 2);
+	int32_t mx, my;
+	motion_posicion(&mx, &my);
+	printf("Posicion final:     (%ld, %ld), medida por el plotter (%ld, %ld)\n",
+	       m.x, m.y, (long)mx, (long)my);
+	printf("Vertices:           %zu -> %s\n", n_puntos, salida);
+	return 0;
+}
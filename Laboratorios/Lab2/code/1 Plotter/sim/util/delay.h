@@ -0,0 +1,13 @@
+/*
+ * util/delay.h (simulador)
+ *
+ * Las esperas activas solo se suman al reloj virtual (ver sim.c).
+ */
+
+#ifndef SIM_DELAY_H_
+#define SIM_DELAY_H_
+
+void _delay_ms(double ms);
+void _delay_us(double us);
+
+#endif /* SIM_DELAY_H_ */
@@ -0,0 +1,322 @@
+"""
+plotter_opt.py
+
+Optimizador de traslados con el lapiz arriba para las figuras del plotter.
+
+Lee tablas de main.c (en formato PK o como lista de codigos de direccion),
+separa los trazos que se dibujan con el lapiz abajo y los vuelve a ordenar
+para recorrer la menor distancia con el lapiz arriba:
+  - orden inicial goloso (vecino mas cercano), probando cada trazo en los
+    dos sentidos y, si es cerrado, entrando por cualquiera de sus puntos;
+  - mejora con 2-opt (invertir un tramo de la secuencia de trazos);
+  - los traslados se rehacen en linea recta (diagonal y despues recto),
+    se sacan las subidas/bajadas de lapiz que sobran y se juntan trazos
+    que quedan uno a continuacion del otro.
+Los traslados se miden en tiempo: un paso diagonal mueve los dos ejes a
+la vez, asi que ir de p a q cuesta max(|dx|, |dy|) pasos.
+
+Por defecto la figura optimizada termina en el mismo punto que la
+original, para que las secuencias que la encadenan no se corran. El
+lapiz empieza y termina como en la original (una figura que no baja el
+lapiz sigue sin bajarlo) y solo cambia en los traslados. Si el orden
+nuevo no ahorra pasos ni bytes se deja la tabla como estaba.
+
+Uso:
+    python plotter_opt.py main.c Flor Murcielago
+    python plotter_opt.py --fin-libre main.c Flor
+    python plotter_opt.py --unir Combinada main.c Flor Murcielago
+"""
+
+import re
+import sys
+
+import plotter_pack as pk
+
+SD = pk.CODIGOS['SOLENOID_DOWN']
+SU = pk.CODIGOS['SOLENOID_UP']
+PASO_MS = 150    # PK_PASO_MS en main.c
+
+# Desplazamiento de cada codigo (x a la derecha, y hacia arriba)
+MOV = {
+    pk.CODIGOS['DOWN']: (0, -1), pk.CODIGOS['UP']: (0, 1),
+    pk.CODIGOS['RIGHT']: (1, 0), pk.CODIGOS['LEFT']: (-1, 0),
+    pk.CODIGOS['UPRIGHT']: (1, 1), pk.CODIGOS['UPLEFT']: (-1, 1),
+    pk.CODIGOS['DOWNRIGHT']: (1, -1), pk.CODIGOS['DOWNLEFT']: (-1, -1),
+}
+CODIGO_MOV = {v: k for k, v in MOV.items()}
+
+
+def leer_pk(src, nombre):
+    """Lee una tabla escrita con las macros PK_* y devuelve sus pasos."""
+    m = re.search(r'\b' + re.escape(nombre) + r'\s*\[\s*\]\s*PROGMEM\s*=\s*\{(.*?)\}\s*;',
+                  src, re.S)
+    if not m:
+        raise SystemExit('No se encontro la tabla ' + nombre)
+    cuerpo = re.sub(r'//[^\n]*', '', m.group(1))
+    if 'PK_' not in cuerpo:
+        return pk.leer_tabla(src, nombre)
+
+    items = []
+    for macro, args in re.findall(r'(PK_\w+)\s*(?:\(([^)]*)\))?', cuerpo):
+        if macro == 'PK_END':
+            break
+        a = [t.strip() for t in args.split(',')]
+        items.append((macro, tuple([int(a[0], 0)] + [pk.CODIGOS[t] for t in a[1:]])))
+    # Se pasa por los bytes para leer exactamente lo que lee pk_next
+    return pk.desempaquetar(pk.a_bytes(items))
+
+
+def trazos(pasos, abajo_inicial):
+    """
+    Separa los pasos en trazos con el lapiz abajo. Cada trazo es la lista
+    de puntos que recorre. Devuelve (trazos, posicion final, lapiz al final).
+    """
+    x = y = 0
+    abajo = abajo_inicial
+    salida = []
+    actual = [(0, 0)] if abajo else None
+    for c in pasos:
+        if c == SD and not abajo:
+            abajo = True
+            actual = [(x, y)]
+        elif c == SU and abajo:
+            abajo = False
+            if len(actual) > 1:
+                salida.append(actual)
+            actual = None
+        elif c in MOV:
+            dx, dy = MOV[c]
+            x += dx
+            y += dy
+            if abajo:
+                actual.append((x, y))
+    if abajo and len(actual) > 1:
+        salida.append(actual)
+    return salida, (x, y), abajo
+
+
+def dist(p, q):
+    return max(abs(p[0] - q[0]), abs(p[1] - q[1]))
+
+
+def es_cerrado(t):
+    return t[0] == t[-1]
+
+
+def orientar(t, entrada):
+    """Arranca el trazo en el indice 'entrada' (o lo invierte si es -1)."""
+    if entrada == -1:
+        return t[::-1]
+    if entrada == 0:
+        return t
+    # Trazo cerrado: se rota para entrar por otro punto
+    return t[entrada:] + t[1:entrada + 1]
+
+
+def mejor_entrada(t, desde, hacia=None):
+    """Elige como recorrer t: sentido o punto de entrada (si es cerrado)."""
+    opciones = [0, -1]
+    if es_cerrado(t):
+        opciones = range(len(t) - 1)
+
+    def costo(e):
+        o = orientar(t, e)
+        return dist(desde, o[0]) + (dist(o[-1], hacia) if hacia is not None else 0)
+
+    return min(opciones, key=costo)
+
+
+def goloso(lista, inicio):
+    pendientes = list(range(len(lista)))
+    orden = []
+    pos = inicio
+    while pendientes:
+        mejor = None
+        for i in pendientes:
+            e = mejor_entrada(lista[i], pos)
+            o = orientar(lista[i], e)
+            d = dist(pos, o[0])
+            if mejor is None or d < mejor[0]:
+                mejor = (d, i, o)
+        _, i, o = mejor
+        pendientes.remove(i)
+        orden.append(o)
+        pos = o[-1]
+    return orden
+
+
+def traslado_total(orden, inicio, fin):
+    total = 0
+    pos = inicio
+    for t in orden:
+        total += dist(pos, t[0])
+        pos = t[-1]
+    if fin is not None:
+        total += dist(pos, fin)
+    return total
+
+
+def dos_opt(orden, inicio, fin):
+    """2-opt: invierte tramos de la secuencia mientras baje el traslado."""
+    mejoro = True
+    costo = traslado_total(orden, inicio, fin)
+    while mejoro:
+        mejoro = False
+        for i in range(len(orden) - 1):
+            for j in range(i + 1, len(orden)):
+                nuevo = orden[:i] + [t[::-1] for t in reversed(orden[i:j + 1])] + orden[j + 1:]
+                c = traslado_total(nuevo, inicio, fin)
+                if c < costo:
+                    orden, costo, mejoro = nuevo, c, True
+        # Con los vecinos ya fijos, los trazos cerrados eligen por donde entrar
+        pos = inicio
+        for k, t in enumerate(orden):
+            sig = orden[k + 1][0] if k + 1 < len(orden) else fin
+            if es_cerrado(t):
+                orden[k] = orientar(t, mejor_entrada(t, pos, sig))
+            pos = orden[k][-1]
+        c = traslado_total(orden, inicio, fin)
+        if c < costo:
+            costo, mejoro = c, True
+    return orden
+
+
+def mover(p, q):
+    """Pasos para ir de p a q: primero diagonal y despues recto."""
+    dx, dy = q[0] - p[0], q[1] - p[1]
+    sx = (dx > 0) - (dx < 0)
+    sy = (dy > 0) - (dy < 0)
+    diag = min(abs(dx), abs(dy))
+    pasos = [CODIGO_MOV[(sx, sy)]] * diag
+    if abs(dx) > diag:
+        pasos += [CODIGO_MOV[(sx, 0)]] * (abs(dx) - diag)
+    elif abs(dy) > diag:
+        pasos += [CODIGO_MOV[(0, sy)]] * (abs(dy) - diag)
+    return pasos
+
+
+def generar(orden, inicio, fin, abajo_inicial, abajo_final):
+    """
+    Arma la lista de pasos; trazos que se tocan se dibujan sin levantar.
+    El lapiz solo sube para los traslados y al final queda como pide
+    abajo_final.
+    """
+    pasos = []
+    pos = inicio
+    abajo = abajo_inicial
+    for t in orden:
+        if pos != t[0]:
+            if abajo:
+                pasos.append(SU)
+                abajo = False
+            pasos += mover(pos, t[0])
+        if not abajo:
+            pasos.append(SD)
+            abajo = True
+        for p, q in zip(t, t[1:]):
+            pasos.append(CODIGO_MOV[(q[0] - p[0], q[1] - p[1])])
+        pos = t[-1]
+    if fin is not None and pos != fin:
+        if abajo:
+            pasos.append(SU)
+            abajo = False
+        pasos += mover(pos, fin)
+    if abajo and not abajo_final:
+        pasos.append(SU)
+    elif not abajo and abajo_final:
+        pasos.append(SD)
+    return pasos
+
+
+def segmentos(lista):
+    """Conjunto de segmentos dibujados (sin sentido), para verificar."""
+    s = set()
+    for t in lista:
+        for p, q in zip(t, t[1:]):
+            s.add((min(p, q), max(p, q)))
+    return s
+
+
+def optimizar(pasos, fin_libre=False):
+    abajo_inicial = SD not in pasos
+    lista, fin, abajo_final = trazos(pasos, abajo_inicial)
+    if fin_libre:
+        fin = None
+
+    orden = dos_opt(goloso(lista, (0, 0)), (0, 0), fin)
+    nuevos = generar(orden, (0, 0), fin, abajo_inicial, abajo_final)
+
+    lista2, fin2, abajo2 = trazos(nuevos, abajo_inicial)
+    assert segmentos(lista2) == segmentos(lista), 'el dibujo cambio'
+    assert fin is None or fin2 == fin, 'el punto final cambio'
+    assert abajo2 == abajo_final, 'el lapiz termina distinto'
+    return nuevos, len(lista), abajo_inicial
+
+
+def traslado_de(pasos, abajo_inicial):
+    abajo = abajo_inicial
+    n = 0
+    for c in pasos:
+        if c == SD:
+            abajo = True
+        elif c == SU:
+            abajo = False
+        elif c in MOV and not abajo:
+            n += 1
+    return n
+
+
+def main(argv):
+    args = argv[1:]
+    fin_libre = '--fin-libre' in args
+    args = [a for a in args if a != '--fin-libre']
+    unir = None
+    if '--unir' in args:
+        k = args.index('--unir')
+        unir = args[k + 1]
+        del args[k:k + 2]
+    if len(args) < 2:
+        print(__doc__)
+        return 1
+
+    with open(args[0], encoding='utf-8', errors='replace') as f:
+        src = f.read()
+
+    tablas = [(n, leer_pk(src, n)) for n in args[1:]]
+    if unir:
+        # Una figura a continuacion de la otra, como en una secuencia
+        todos = []
+        for _, p in tablas:
+            if SD not in p:
+                p = [SD] + p + [SU]
+            todos += p
+        tablas = [(unir, todos)]
+
+    for nombre, pasos in tablas:
+        nuevos, n_trazos, abajo_inicial = optimizar(pasos, fin_libre)
+        if abajo_inicial:
+            print('// %s no baja el lapiz: se toma como si empezara abajo' % nombre)
+
+        items = pk.empaquetar(nuevos)
+        datos = pk.a_bytes(items)
+        assert pk.desempaquetar(datos) == nuevos, 'error de empaquetado en ' + nombre
+
+        # Mas pasos es mas tiempo de dibujo: solo se acepta si baja el total
+        # o, con el mismo total, si ocupa menos
+        items0 = pk.empaquetar(pasos)
+        datos0 = pk.a_bytes(items0)
+        if (len(nuevos), len(datos)) >= (len(pasos), len(datos0)):
+            print('// %s: el orden nuevo no mejora, se deja como estaba' % nombre)
+            nuevos, items, datos = pasos, items0, datos0
+
+        antes, despues = traslado_de(pasos, abajo_inicial), traslado_de(nuevos, abajo_inicial)
+        print('// %s: %d trazos, traslado %d -> %d pasos, total %d -> %d pasos '
+              '(%.1f s -> %.1f s), %d bytes'
+              % (nombre, n_trazos, antes, despues, len(pasos), len(nuevos),
+                 len(pasos) * PASO_MS / 1000.0, len(nuevos) * PASO_MS / 1000.0, len(datos)))
+        print(pk.formatear(nombre, items))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,192 @@
+"""
+plotter_pack.py
+
+Empaquetador de figuras para el plotter (formato PK, ver main.c).
+
+Lee tablas de pasos escritas como listas de codigos de direccion
+(por ejemplo "const uint16_t Flor[] PROGMEM = {SOLENOID_DOWN, LEFT, ...}")
+y genera la tabla equivalente en formato empaquetado usando las macros
+PK_RUN / PK_PAIR / PK_LRUN / PK_LPAIR / PK_END de main.c.
+
+Uso:
+    python plotter_pack.py main.c Flor Murcielago
+"""
+
+import re
+import sys
+
+# Codigos de direccion (mismos valores que los #define de main.c)
+CODIGOS = {
+    'SOLENOID_DOWN': 1, 'SOLENOIDDOWN': 1, 'SD': 1,
+    'SOLENOID_UP': 2, 'SOLENOIDUP': 2, 'SU': 2,
+    'DOWN': 3, 'D': 3,
+    'UP': 4, 'U': 4,
+    'RIGHT': 5, 'R': 5,
+    'LEFT': 6, 'L': 6,
+    'STOP': 7, 'S': 7,
+    'UPRIGHT': 8, 'UP_RIGHT': 8, 'UR': 8,
+    'UPLEFT': 9, 'UP_LEFT': 9, 'UL': 9,
+    'DOWNRIGHT': 10, 'DOWN_RIGHT': 10, 'DR': 10,
+    'DOWNLEFT': 11, 'DOWN_LEFT': 11, 'DL': 11,
+}
+
+NOMBRES = {1: 'SOLENOID_DOWN', 2: 'SOLENOID_UP', 3: 'DOWN', 4: 'UP',
+           5: 'RIGHT', 6: 'LEFT', 7: 'STOP', 8: 'UPRIGHT', 9: 'UPLEFT',
+           10: 'DOWNRIGHT', 11: 'DOWNLEFT'}
+
+# Codigos de operacion (nibble bajo)
+PK_OP_PAIR = 0x0C
+PK_OP_LRUN = 0x0D
+PK_OP_LPAIR = 0x0E
+
+RUN_MAX = 16      # PK_RUN:   1 byte,  1..16 pasos
+LRUN_MAX = 256    # PK_LRUN:  2 bytes, 1..256 pasos
+PAIR_MAX = 16     # PK_PAIR:  2 bytes, 1..16 repeticiones del par
+LPAIR_MAX = 4096  # PK_LPAIR: 3 bytes, 1..4096 repeticiones del par
+
+
+def leer_tabla(src, nombre):
+    """Devuelve la lista de codigos de la tabla 'nombre' dentro de src."""
+    m = re.search(r'\b' + re.escape(nombre) + r'\s*\[\s*\]\s*PROGMEM\s*=\s*\{(.*?)\}\s*;',
+                  src, re.S)
+    if not m:
+        raise SystemExit('No se encontro la tabla ' + nombre)
+    cuerpo = re.sub(r'//[^\n]*', '', m.group(1))
+    pasos = []
+    for tok in cuerpo.split(','):
+        tok = tok.strip()
+        if not tok:
+            continue
+        pasos.append(int(tok, 0) if tok[0].isdigit() else CODIGOS[tok])
+    # STOP cortaba la ejecucion en ejecutar_circulo_sinc2: lo reemplaza PK_END
+    if STOP_CODE in pasos:
+        pasos = pasos[:pasos.index(STOP_CODE)]
+    return pasos
+
+
+STOP_CODE = 7
+
+
+def empaquetar(pasos):
+    """
+    Empaqueta una lista de codigos con programacion dinamica (menor
+    cantidad de bytes). Devuelve una lista de tuplas (macro, args, bytes).
+    """
+    n = len(pasos)
+    INF = float('inf')
+    costo = [INF] * (n + 1)
+    eleccion = [None] * (n + 1)
+    costo[n] = 0
+
+    for i in range(n - 1, -1, -1):
+        d = pasos[i]
+        # Corridas de un mismo codigo
+        largo = 1
+        while i + largo < n and pasos[i + largo] == d and largo < LRUN_MAX:
+            largo += 1
+        for k in range(1, largo + 1):
+            c = (1 if k <= RUN_MAX else 2) + costo[i + k]
+            if c < costo[i]:
+                costo[i] = c
+                eleccion[i] = ('PK_RUN' if k <= RUN_MAX else 'PK_LRUN', (k, d), k)
+        # Pares alternados (a, b) repetidos
+        if i + 1 < n and pasos[i + 1] != d:
+            a, b = d, pasos[i + 1]
+            rep = 1
+            while (i + 2 * rep + 1 < n and pasos[i + 2 * rep] == a
+                   and pasos[i + 2 * rep + 1] == b and rep < LPAIR_MAX):
+                rep += 1
+            for k in range(1, rep + 1):
+                c = (2 if k <= PAIR_MAX else 3) + costo[i + 2 * k]
+                if c < costo[i]:
+                    costo[i] = c
+                    eleccion[i] = ('PK_PAIR' if k <= PAIR_MAX else 'PK_LPAIR', (k, a, b), 2 * k)
+
+    salida = []
+    i = 0
+    while i < n:
+        macro, args, avance = eleccion[i]
+        salida.append((macro, args))
+        i += avance
+    return salida
+
+
+def a_bytes(items):
+    """Traduce la lista de macros a bytes (igual que las macros de main.c)."""
+    out = []
+    for macro, args in items:
+        if macro == 'PK_RUN':
+            k, d = args
+            out.append(((k - 1) << 4) | d)
+        elif macro == 'PK_LRUN':
+            k, d = args
+            out += [(d << 4) | PK_OP_LRUN, k - 1]
+        elif macro == 'PK_PAIR':
+            k, a, b = args
+            out += [((k - 1) << 4) | PK_OP_PAIR, (a << 4) | b]
+        elif macro == 'PK_LPAIR':
+            k, a, b = args
+            out += [(((k - 1) >> 8) << 4) | PK_OP_LPAIR, (k - 1) & 0xFF, (a << 4) | b]
+    out.append(0x00)
+    return out
+
+
+def desempaquetar(datos):
+    """Decodificador de referencia (misma logica que pk_next en main.c)."""
+    pasos = []
+    i = 0
+    while True:
+        b = datos[i]
+        i += 1
+        op, hi = b & 0x0F, b >> 4
+        if op == 0 or op == 0x0F:
+            return pasos
+        if op <= 11:
+            pasos += [op] * (hi + 1)
+        elif op == PK_OP_LRUN:
+            pasos += [hi] * (datos[i] + 1)
+            i += 1
+        elif op == PK_OP_PAIR:
+            p = datos[i]
+            i += 1
+            pasos += [p >> 4, p & 0x0F] * (hi + 1)
+        elif op == PK_OP_LPAIR:
+            k = ((hi << 8) | datos[i]) + 1
+            p = datos[i + 1]
+            i += 2
+            pasos += [p >> 4, p & 0x0F] * k
+
+
+def formatear(nombre, items, por_linea=4):
+    partes = []
+    for macro, args in items:
+        if macro in ('PK_RUN', 'PK_LRUN'):
+            partes.append('%s(%d, %s)' % (macro, args[0], NOMBRES[args[1]]))
+        else:
+            partes.append('%s(%d, %s, %s)' % (macro, args[0], NOMBRES[args[1]], NOMBRES[args[2]]))
+    partes.append('PK_END')
+    lineas = []
+    for j in range(0, len(partes), por_linea):
+        lineas.append('\t' + ', '.join(partes[j:j + por_linea]) + ',')
+    lineas[-1] = lineas[-1][:-1]
+    return 'const uint8_t %s[] PROGMEM = {\n%s\n};\n' % (nombre, '\n'.join(lineas))
+
+
+def main(argv):
+    if len(argv) < 3:
+        print(__doc__)
+        return 1
+    with open(argv[1], encoding='utf-8', errors='replace') as f:
+        src = f.read()
+    for nombre in argv[2:]:
+        pasos = leer_tabla(src, nombre)
+        items = empaquetar(pasos)
+        datos = a_bytes(items)
+        assert desempaquetar(datos) == pasos, 'error de empaquetado en ' + nombre
+        print('// %s: %d pasos, %d bytes (antes %d bytes)' % (nombre, len(pasos), len(datos), 2 * len(pasos)))
+        print(formatear(nombre, items))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
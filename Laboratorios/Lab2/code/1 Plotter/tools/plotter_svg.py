@@ -0,0 +1,463 @@
+"""
+plotter_svg.py
+
+Compilador de dibujos a tablas del plotter.
+
+Lee un SVG (path, polyline, polygon, line, rect, circle, ellipse; las
+curvas y arcos se dividen en rectas y despues se simplifican con
+Douglas-Peucker hasta --tol ms de error) o una lista de puntos en texto
+("x y" por linea, una linea vacia separa trazos) y genera un header listo
+para incluir en main.c, en uno de los dos formatos del ejecutor:
+
+  pk     pasos de las 8 direcciones (tabla PK, ver main.c). La figura se
+         cuantiza a una grilla de un paso por celda con Bresenham y se
+         empaqueta con plotter_pack; cada paso dura --ms (PK_PASO_MS).
+  tramo  lista de Tramo con TR_LINEA en ms de motor (TRABAJO_VECTOR); el
+         motor de lineas del micro elige rectos y diagonales.
+
+El dibujo se escala para que su lado mayor mida --tam ms de motor, con
+y hacia arriba. La figura arranca en el primer punto del dibujo (ahi
+tiene que estar el lapiz) y los traslados se hacen con el lapiz arriba.
+Con --optimizar los trazos se ordenan con plotter_opt para acortar los
+traslados.
+
+Al final informa el tiempo estimado de dibujo y lo que ocupa en flash.
+
+Uso:
+    python plotter_svg.py flor.svg -n Flor2 -o flor2.h
+    python plotter_svg.py puntos.txt -n Casa -f tramo --tam 12000
+"""
+
+import argparse
+import math
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+import plotter_opt
+import plotter_pack as pk
+
+SD = pk.CODIGOS['SOLENOID_DOWN']
+SU = pk.CODIGOS['SOLENOID_UP']
+PK_EXTRA_MS = 2000       # PK_INICIO + PK_FIN en main.c
+TRAMO_BYTES = 7          # sizeof(Tramo) en AVR (sin relleno)
+TRAMO_PLUMA_MS = 200     # espera del solenoide en las tablas de Tramo
+INT16_MAX = 32767
+CURVA_PARTES = 64        # rectas por curva antes de simplificar
+
+
+# ------------------------------------------------------------------
+# Lectura: todo termina como una lista de trazos (listas de puntos)
+# ------------------------------------------------------------------
+
+def mat_mul(a, b):
+    return (a[0] * b[0] + a[2] * b[1], a[1] * b[0] + a[3] * b[1],
+            a[0] * b[2] + a[2] * b[3], a[1] * b[2] + a[3] * b[3],
+            a[0] * b[4] + a[2] * b[5] + a[4], a[1] * b[4] + a[3] * b[5] + a[5])
+
+
+IDENTIDAD = (1, 0, 0, 1, 0, 0)
+
+
+def leer_transform(texto):
+    m = IDENTIDAD
+    for nombre, args in re.findall(r'(\w+)\s*\(([^)]*)\)', texto or ''):
+        v = [float(x) for x in re.findall(r'[-+]?(?:\d+\.?\d*|\.\d+)(?:[eE][-+]?\d+)?', args)]
+        if nombre == 'matrix' and len(v) == 6:
+            t = tuple(v)
+        elif nombre == 'translate':
+            t = (1, 0, 0, 1, v[0], v[1] if len(v) > 1 else 0)
+        elif nombre == 'scale':
+            t = (v[0], 0, 0, v[1] if len(v) > 1 else v[0], 0, 0)
+        elif nombre == 'rotate':
+            a = math.radians(v[0])
+            t = (math.cos(a), math.sin(a), -math.sin(a), math.cos(a), 0, 0)
+            if len(v) == 3:
+                t = mat_mul((1, 0, 0, 1, v[1], v[2]), mat_mul(t, (1, 0, 0, 1, -v[1], -v[2])))
+        else:
+            raise SystemExit('transform no soportado: ' + nombre)
+        m = mat_mul(m, t)
+    return m
+
+
+def aplicar(m, p):
+    return (m[0] * p[0] + m[2] * p[1] + m[4], m[1] * p[0] + m[3] * p[1] + m[5])
+
+
+def bezier(p0, p1, p2, p3):
+    n = CURVA_PARTES
+    pts = []
+    for i in range(1, n + 1):
+        t = i / n
+        u = 1 - t
+        pts.append((u ** 3 * p0[0] + 3 * u * u * t * p1[0] + 3 * u * t * t * p2[0] + t ** 3 * p3[0],
+                    u ** 3 * p0[1] + 3 * u * u * t * p1[1] + 3 * u * t * t * p2[1] + t ** 3 * p3[1]))
+    return pts
+
+
+def arco_svg(p0, rx, ry, rot, grande, barrido, p1):
+    """Arco eliptico de SVG (A) pasado a centro y angulos (SVG 1.1, F.6.5)."""
+    if rx == 0 or ry == 0 or p0 == p1:
+        return [p1]
+    rx, ry = abs(rx), abs(ry)
+    fi = math.radians(rot)
+    c, s = math.cos(fi), math.sin(fi)
+    dx, dy = (p0[0] - p1[0]) / 2, (p0[1] - p1[1]) / 2
+    x1 = c * dx + s * dy
+    y1 = -s * dx + c * dy
+    lam = x1 * x1 / (rx * rx) + y1 * y1 / (ry * ry)
+    if lam > 1:
+        rx *= math.sqrt(lam)
+        ry *= math.sqrt(lam)
+    num = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1
+    den = rx * rx * y1 * y1 + ry * ry * x1 * x1
+    k = math.sqrt(max(0, num / den))
+    if grande == barrido:
+        k = -k
+    cx1, cy1 = k * rx * y1 / ry, -k * ry * x1 / rx
+    cx = c * cx1 - s * cy1 + (p0[0] + p1[0]) / 2
+    cy = s * cx1 + c * cy1 + (p0[1] + p1[1]) / 2
+    a0 = math.atan2((y1 - cy1) / ry, (x1 - cx1) / rx)
+    a1 = math.atan2((-y1 - cy1) / ry, (-x1 - cx1) / rx)
+    da = a1 - a0
+    if barrido and da < 0:
+        da += 2 * math.pi
+    elif not barrido and da > 0:
+        da -= 2 * math.pi
+    n = CURVA_PARTES
+    pts = []
+    for i in range(1, n + 1):
+        a = a0 + da * i / n
+        ex, ey = rx * math.cos(a), ry * math.sin(a)
+        pts.append((c * ex - s * ey + cx, s * ex + c * ey + cy))
+    pts[-1] = p1
+    return pts
+
+
+def leer_path(d):
+    tokens = re.findall(r'[MmLlHhVvZzCcSsQqTtAa]|[-+]?(?:\d+\.?\d*|\.\d+)(?:[eE][-+]?\d+)?', d)
+    trazos = []
+    actual = []
+    pos = inicio = (0.0, 0.0)
+    ctrl = None            # ultimo punto de control (para S y T)
+    cmd = None
+    i = 0
+
+    def num():
+        nonlocal i
+        v = float(tokens[i])
+        i += 1
+        return v
+
+    while i < len(tokens):
+        if tokens[i].isalpha():
+            cmd = tokens[i]
+            i += 1
+            if cmd in 'Zz':
+                if actual:
+                    actual.append(inicio)
+                pos = inicio
+                ctrl = None
+                continue
+        elif cmd is None:
+            raise SystemExit('path sin comando inicial')
+
+        rel = cmd.islower()
+        C = cmd.upper()
+        ox, oy = pos if rel else (0.0, 0.0)
+
+        if C == 'M':
+            if len(actual) > 1:
+                trazos.append(actual)
+            pos = inicio = (ox + num(), oy + num())
+            actual = [pos]
+            cmd = 'l' if rel else 'L'         # pares siguientes son L
+            ctrl = None
+            continue
+        if not actual:
+            actual = [pos]
+
+        if C == 'L':
+            pos = (ox + num(), oy + num())
+            actual.append(pos)
+            ctrl = None
+        elif C == 'H':
+            pos = ((pos[0] if rel else 0.0) + num(), pos[1])
+            actual.append(pos)
+            ctrl = None
+        elif C == 'V':
+            pos = (pos[0], (pos[1] if rel else 0.0) + num())
+            actual.append(pos)
+            ctrl = None
+        elif C in 'CS':
+            if C == 'C':
+                c1 = (ox + num(), oy + num())
+            else:
+                c1 = (2 * pos[0] - ctrl[0], 2 * pos[1] - ctrl[1]) if ctrl else pos
+            c2 = (ox + num(), oy + num())
+            p = (ox + num(), oy + num())
+            actual += bezier(pos, c1, c2, p)
+            pos, ctrl = p, c2
+        elif C in 'QT':
+            if C == 'Q':
+                q = (ox + num(), oy + num())
+            else:
+                q = (2 * pos[0] - ctrl[0], 2 * pos[1] - ctrl[1]) if ctrl else pos
+            p = (ox + num(), oy + num())
+            # Cuadratica como cubica equivalente
+            c1 = (pos[0] + 2 / 3 * (q[0] - pos[0]), pos[1] + 2 / 3 * (q[1] - pos[1]))
+            c2 = (p[0] + 2 / 3 * (q[0] - p[0]), p[1] + 2 / 3 * (q[1] - p[1]))
+            actual += bezier(pos, c1, c2, p)
+            pos, ctrl = p, q
+        elif C == 'A':
+            rx, ry, rot, grande, barrido = num(), num(), num(), num(), num()
+            p = (ox + num(), oy + num())
+            actual += arco_svg(pos, rx, ry, rot, int(grande), int(barrido), p)
+            pos = p
+            ctrl = None
+    if len(actual) > 1:
+        trazos.append(actual)
+    return trazos
+
+
+def elipse(cx, cy, rx, ry):
+    n = 2 * CURVA_PARTES
+    return [[(cx + rx * math.cos(2 * math.pi * i / n), cy + ry * math.sin(2 * math.pi * i / n))
+             for i in range(n + 1)]]
+
+
+def leer_svg(ruta):
+    trazos = []
+
+    def f(e, nombre, defecto=0.0):
+        v = e.get(nombre)
+        return float(re.match(r'[-+]?[\d.eE+-]+', v).group(0)) if v else defecto
+
+    def recorrer(e, m):
+        m = mat_mul(m, leer_transform(e.get('transform')))
+        tag = e.tag.split('}')[-1]
+        nuevos = []
+        if tag == 'path':
+            nuevos = leer_path(e.get('d', ''))
+        elif tag in ('polyline', 'polygon'):
+            v = [float(x) for x in re.findall(r'[-+]?(?:\d+\.?\d*|\.\d+)(?:[eE][-+]?\d+)?', e.get('points', ''))]
+            pts = list(zip(v[0::2], v[1::2]))
+            if tag == 'polygon' and pts:
+                pts.append(pts[0])
+            nuevos = [pts]
+        elif tag == 'line':
+            nuevos = [[(f(e, 'x1'), f(e, 'y1')), (f(e, 'x2'), f(e, 'y2'))]]
+        elif tag == 'rect':
+            x, y, w, h = f(e, 'x'), f(e, 'y'), f(e, 'width'), f(e, 'height')
+            nuevos = [[(x, y), (x + w, y), (x + w, y + h), (x, y + h), (x, y)]]
+        elif tag == 'circle':
+            r = f(e, 'r')
+            nuevos = elipse(f(e, 'cx'), f(e, 'cy'), r, r)
+        elif tag == 'ellipse':
+            nuevos = elipse(f(e, 'cx'), f(e, 'cy'), f(e, 'rx'), f(e, 'ry'))
+        for t in nuevos:
+            if len(t) > 1:
+                trazos.append([aplicar(m, p) for p in t])
+        for hijo in e:
+            if hijo.tag.split('}')[-1] not in ('defs', 'clipPath', 'mask', 'symbol'):
+                recorrer(hijo, m)
+
+    recorrer(ET.parse(ruta).getroot(), IDENTIDAD)
+    # SVG tiene y hacia abajo; el plotter, hacia arriba
+    return [[(x, -y) for x, y in t] for t in trazos]
+
+
+def leer_puntos(ruta):
+    trazos = [[]]
+    with open(ruta, encoding='utf-8') as f:
+        for linea in f:
+            linea = linea.split('#')[0].strip()
+            if not linea:
+                if trazos[-1]:
+                    trazos.append([])
+                continue
+            x, y = [float(v) for v in re.split(r'[\s,;]+', linea)[:2]]
+            trazos[-1].append((x, y))
+    return [t for t in trazos if len(t) > 1]
+
+
+# ------------------------------------------------------------------
+# Escala y generacion
+# ------------------------------------------------------------------
+
+def escalar(trazos, tam):
+    """Escala para que el lado mayor mida tam y pone el primer punto en (0, 0)."""
+    xs = [p[0] for t in trazos for p in t]
+    ys = [p[1] for t in trazos for p in t]
+    lado = max(max(xs) - min(xs), max(ys) - min(ys)) or 1.0
+    k = tam / lado
+    x0, y0 = trazos[0][0]
+    return [[((x - x0) * k, (y - y0) * k) for x, y in t] for t in trazos]
+
+
+def simplificar(t, tol):
+    """Douglas-Peucker: saca los puntos que se apartan menos de tol de la recta."""
+    if len(t) < 3:
+        return t
+    a, b = t[0], t[-1]
+    dx, dy = b[0] - a[0], b[1] - a[1]
+    largo = math.hypot(dx, dy)
+    peor, k = -1.0, 0
+    for i in range(1, len(t) - 1):
+        p = t[i]
+        if largo:
+            d = abs(dx * (p[1] - a[1]) - dy * (p[0] - a[0])) / largo
+        else:
+            d = math.dist(p, a)
+        if d > peor:
+            peor, k = d, i
+    if peor <= tol:
+        return [a, b]
+    return simplificar(t[:k + 1], tol)[:-1] + simplificar(t[k:], tol)
+
+
+def pasos_pk(trazos, celda):
+    """Cuantiza a la grilla (un paso por celda) y genera los codigos de direccion."""
+    pasos = []
+    pos = (0, 0)
+    abajo = False
+    for t in trazos:
+        grilla = [(round(x / celda), round(y / celda)) for x, y in t]
+        if grilla[0] != pos:
+            if abajo:
+                pasos.append(SU)
+                abajo = False
+            pasos += plotter_opt.mover(pos, grilla[0])
+            pos = grilla[0]
+        for q in grilla[1:]:
+            dx, dy = q[0] - pos[0], q[1] - pos[1]
+            n = max(abs(dx), abs(dy))
+            if n == 0:
+                continue
+            if not abajo:
+                pasos.append(SD)
+                abajo = True
+            # Bresenham: en cada paso cada eje avanza 0 o 1 para seguir la recta
+            px, py = 0, 0
+            for i in range(1, n + 1):
+                nx, ny = round(i * dx / n), round(i * dy / n)
+                pasos.append(plotter_opt.CODIGO_MOV[(nx - px, ny - py)])
+                px, py = nx, ny
+            pos = q
+    if abajo:
+        pasos.append(SU)
+    return pasos
+
+
+def tramos(trazos):
+    """Lista de (op, x) / (TR_LINEA, dx, dy) en ms; las coordenadas se redondean
+    en absoluto para que los errores no se acumulen."""
+    salida = []
+    pos = (0, 0)
+
+    def recta(a, b):
+        dx, dy = b[0] - a[0], b[1] - a[1]
+        n = max(1, math.ceil(max(abs(dx), abs(dy)) / INT16_MAX))
+        for i in range(n):
+            salida.append(('TR_LINEA', dx // n + (1 if i < dx % n else 0),
+                           dy // n + (1 if i < dy % n else 0)))
+
+    for t in trazos:
+        puntos = [(round(x), round(y)) for x, y in t]
+        if puntos[0] != pos:
+            recta(pos, puntos[0])
+        salida.append(('SOLENOID_DOWN', TRAMO_PLUMA_MS))
+        for a, b in zip(puntos, puntos[1:]):
+            if a != b:
+                recta(a, b)
+        salida.append(('SOLENOID_UP', TRAMO_PLUMA_MS))
+        pos = puntos[-1]
+    return salida
+
+
+def tiempo_tramos(lista):
+    ms = 0
+    for t in lista:
+        ms += max(abs(t[1]), abs(t[2])) if t[0] == 'TR_LINEA' else t[1]
+    return ms
+
+
+def formatear_tramos(nombre, lista, por_linea=3):
+    partes = []
+    for t in lista:
+        if t[0] == 'TR_LINEA':
+            partes.append('{TR_LINEA, %d, %d}' % (t[1], t[2]))
+        else:
+            partes.append('{%s, %d, 0}' % (t[0], t[1]))
+    partes.append('{TR_FIN, 0, 0}')
+    lineas = ['\t' + ', '.join(partes[j:j + por_linea]) + ','
+              for j in range(0, len(partes), por_linea)]
+    lineas[-1] = lineas[-1][:-1]
+    return 'const Tramo %s[] PROGMEM = {\n%s\n};\n' % (nombre, '\n'.join(lineas))
+
+
+def mmss(ms):
+    s = int(round(ms / 1000.0))
+    return '%d:%02d' % (s // 60, s % 60)
+
+
+def main(argv):
+    ap = argparse.ArgumentParser(description='Compila SVG o listas de puntos a tablas del plotter.')
+    ap.add_argument('entrada', help='archivo .svg o lista de puntos')
+    ap.add_argument('-n', '--nombre', default='Figura', help='nombre de la tabla en C')
+    ap.add_argument('-o', '--salida', help='header a generar (por defecto, la salida estandar)')
+    ap.add_argument('-f', '--formato', choices=('pk', 'tramo'), default='pk')
+    ap.add_argument('--tam', type=float, default=24000, help='lado mayor del dibujo, en ms de motor')
+    ap.add_argument('--ms', type=int, default=150, help='duracion de un paso PK (PK_PASO_MS)')
+    ap.add_argument('--tol', type=float, default=50, help='error permitido al simplificar, en ms de motor')
+    ap.add_argument('--optimizar', action='store_true', help='ordenar trazos para acortar traslados (solo pk)')
+    a = ap.parse_args(argv[1:])
+
+    if a.entrada.lower().endswith('.svg'):
+        trazos = leer_svg(a.entrada)
+    else:
+        trazos = leer_puntos(a.entrada)
+    if not trazos:
+        raise SystemExit('no hay trazos en ' + a.entrada)
+    trazos = [simplificar(t, a.tol) for t in escalar(trazos, a.tam)]
+
+    guarda = re.sub(r'\W', '_', a.nombre).upper() + '_H_'
+    texto = ['// Generado con tools/plotter_svg.py desde %s' % a.entrada.split('/')[-1]]
+
+    if a.formato == 'pk':
+        pasos = pasos_pk(trazos, a.ms)
+        if a.optimizar:
+            pasos = plotter_opt.optimizar(pasos, fin_libre=True)[0]
+        items = pk.empaquetar(pasos)
+        datos = pk.a_bytes(items)
+        assert pk.desempaquetar(datos) == pasos, 'error de empaquetado'
+        ms = len(pasos) * a.ms + PK_EXTRA_MS
+        bytes_flash = len(datos)
+        texto.append('// %d pasos de %d ms, %s estimado, %d bytes de flash'
+                     % (len(pasos), a.ms, mmss(ms), bytes_flash))
+        if a.ms != 150:
+            texto.append('// Ojo: main.c usa PK_PASO_MS 150; con otro valor cambia el tamano')
+        texto.append('// Catalogo: {"%s", TRABAJO_PK, %s},' % (a.nombre, a.nombre))
+        tabla = pk.formatear(a.nombre, items)
+    else:
+        lista = tramos(trazos)
+        ms = tiempo_tramos(lista)
+        bytes_flash = (len(lista) + 1) * TRAMO_BYTES
+        texto.append('// %d tramos, %s estimado, %d bytes de flash' % (len(lista), mmss(ms), bytes_flash))
+        texto.append('// Catalogo: {"%s", TRABAJO_VECTOR, %s},' % (a.nombre, a.nombre))
+        tabla = formatear_tramos(a.nombre, lista)
+
+    header = '\n'.join(texto) + '\n\n#ifndef %s\n#define %s\n\n%s\n#endif /* %s */\n' % (guarda, guarda, tabla, guarda)
+    if a.salida:
+        with open(a.salida, 'w') as f:
+            f.write(header)
+    else:
+        sys.stdout.write(header)
+
+    print('%s: %d trazos, tiempo estimado %s (%d ms), %d bytes de flash'
+          % (a.nombre, len(trazos), mmss(ms), ms, bytes_flash), file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
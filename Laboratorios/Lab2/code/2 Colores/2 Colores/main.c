@@ -45,7 +45,15 @@ Proceso de Funcionamiento
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stddef.h>
 #include <string.h>
+#include <stdlib.h>
+#include "../../comun/formato.h"
+#include "../../comun/formato.c"
 
 // -----------------------------------------------------------------
 // DEFINITIONS
@@ -58,57 +66,219 @@ Proceso de Funcionamiento
 #define RX_BUF_SZ 256
 #define RX_MASK   (RX_BUF_SZ - 1)
 #define BAUD_RATE 9600
-
+// Modo binario: registros COBS con CRC a BAUD_BIN (a 16 MHz son exactos
+// 250000, 500000 y 1000000)
+#define BAUD_BIN  250000
+#define BIN_MODE  0                  // 1 = arrancar en binario
+#define REC_RGB   1                  // tipo de registro: vuelta clasificada
+#define REC_LEN   15                 // bytes del registro, sin el CRC
+
+// Tira WS2812: 1 = datos por el SPI (MOSI, PB3), 0 = bit-bang en PD6.
+// Con el SPI, MOSI y MISO (PB3, PB4) dejan de estar libres y el led RGB
+// iluminador pasa a PC1..PC3.
+#define WS2812_SPI 1
+
+#if WS2812_SPI
+#define RGB_PORT PORTC
+#define RGB_DDR  DDRC
+#define RED   PORTC1
+#define GREEN PORTC2
+#define BLUE  PORTC3
+#else
+#define RGB_PORT PORTB
+#define RGB_DDR  DDRB
 #define RED   PORTB2
 #define GREEN PORTB3
 #define BLUE  PORTB4
+#endif
 
 #define SERVO_PORT PORTB
 #define SERVO_DDR DDRB
 #define SERVO_PIN PORTB1
 
+// Servo: el pulso (en ticks de 0,5 us) va hacia el angulo pedido con un
+// perfil trapezoidal que avanza cada 20 ms (un periodo del PWM)
+#define SERVO_VMAX        120        // ticks por periodo (multiplo de SERVO_ACCEL): 0 a 180 grados en 0,8 s
+#define SERVO_ACCEL       20         // ticks por periodo, por periodo
+#define SERVO_SETTLE      3          // periodos de espera al llegar
+#define SERVO_SETTLE_FIRST 40        // el primer angulo: no se sabe de donde viene
+#define SERVO_HOLD        1          // 1 = no medir mientras el servo se mueve
+
+#if WS2812_SPI
+#define LED_PORT PORTB
+#define LED_DDR  DDRB
+#define LED_PIN  PORTB3              // MOSI
+#else
 #define LED_PORT PORTD
 #define LED_DDR  DDRD
 #define LED_PIN  PORTD6
-
-#define NUM_COLORS (sizeof(color_refs)/sizeof(color_refs[0]))
+#endif
+
+#define LED_COUNT 50                 // leds de la tira
+
+// ADC: cada medicion suma 4^ADC_EXTRA_BITS conversiones y se decima a
+// 10 + ADC_EXTRA_BITS bits (16 muestras -> 12 bits, unos 1,7 ms)
+#define ADC_EXTRA_BITS 2
+#define ADC_OVERSAMPLE (1 << (2 * ADC_EXTRA_BITS))
+#define ADC10(v)       ((v) << ADC_EXTRA_BITS)     // valor medido a 10 bits -> escala actual
+// 1 = mientras hay una medicion en curso el lazo principal duerme en modo
+// de reduccion de ruido del ADC (ver main_sleep). En ese modo se frena el
+// reloj de E/S: la UART no recibe, el Timer2 se atrasa y el pulso del
+// servo se estira mientras se duerme, por eso queda apagado
+#define ADC_SLEEP 0
+
+// Muestreo (Timer2, 1 ms): por cada fase se prende el iluminador, se
+// espera que la fotocelda se asiente y se mide. La fase oscura (opcional)
+// mide con el iluminador apagado y se resta de R, G y B.
+#define PHASE_DARK   0
+#define PHASE_RED    1
+#define PHASE_GREEN  2
+#define PHASE_BLUE   3
+#define SETTLE_MS    20              // espera por defecto de cada fase
+#define DARK_FRAME   0               // 1 = restar la luz ambiente
+#define PRINT_MAX    128             // largo maximo de print_data
+
+// Calibracion por UART: cada referencia es el promedio de CAL_FRAMES
+// vueltas del muestreo. Se guarda en la EEPROM con un CRC.
+#define CAL_FRAMES   16
+#define CAL_VERSION  1               // cambiar si cambia el bloque o la escala del ADC
+#define CMD_MAX      16              // largo maximo de un comando
+
+// Clasificador: distancia en cromaticidad (r y g sobre r + g + b, escala
+// 255), que no cambia si toda la lectura sube o baja con la luz. El brillo
+// no cuenta para el rechazo; solo separa colores de la misma cromaticidad.
+#define CHROMA_RADIUS  16            // mas lejos en cromaticidad de toda referencia = desconocido
+#define LUMA_SHIFT     4             // brillo = (r + g + b) >> LUMA_SHIFT
+#define LUMA_W_SHIFT   2             // el brillo pesa dl^2 >> LUMA_W_SHIFT (16 = nada)
+#define COLOR_UNKNOWN  0xFF
+#ifndef CLASSIFY_BENCH               // solo para medir: -DCLASSIFY_BENCH=1
+#define CLASSIFY_BENCH 0             // comando 'b': ciclos contra el clasificador RGB
+#endif
+#ifndef FORMAT_BENCH                 // solo para medir: -DFORMAT_BENCH=1
+#define FORMAT_BENCH   0             // comando 'b': ciclos de UTOA y utoa contra fmt_u16
+#endif
+
+#define NUM_COLORS (sizeof(color_profiles)/sizeof(color_profiles[0]))
+#define NAME_MAX   11                // "AZUL CLARO" + '\0'
+#define SERVO_KEEP 0xFF              // el color no mueve el servo
 
 // ------------------------------------------------------------------
 // PROGRAM VARIABLES
 // ------------------------------------------------------------------
 
 
-// Mapeado de colores
+// Perfil de cada color: todo lo que depende del color detectado sale de
+// esta tabla (en flash), buscando por el indice que da identify_color
 typedef struct {
-	const char *name;
-	uint16_t r, g, b;
-} ColorRef;
-
-const ColorRef color_refs[] = {
-	{"MORADO",    216, 157, 274},
-	{"ROJO",       206, 149, 262},
-	{"AMARILLO",    196, 99, 105},
-	{"VERDE",     272, 192, 152},
-	{"AZUL CLARO", 151, 153, 122},
-	{"VIOLETA",    253, 275, 338},
-	{"BLANCO",    110, 93, 91},
+	char     name[NAME_MAX];
+	uint16_t r, g, b;                // referencia de fabrica
+	uint8_t  led_r, led_g, led_b;    // color que muestra la tira
+	uint8_t  angle;                  // angulo del servo (SERVO_KEEP = no se mueve)
+} ColorProfile;
+
+// Referencias tomadas con el ADC de 10 bits
+const ColorProfile color_profiles[] PROGMEM = {
+	{"MORADO",     ADC10(216), ADC10(157), ADC10(274), 200,   0,  75, SERVO_KEEP},
+	{"ROJO",       ADC10(206), ADC10(149), ADC10(262), 255,   0,   0,   0},
+	{"AMARILLO",   ADC10(196), ADC10(99),  ADC10(105), 255, 100,   0,  60},
+	{"VERDE",      ADC10(272), ADC10(192), ADC10(152),   0, 255,   0, 120},
+	{"AZUL CLARO", ADC10(151), ADC10(153), ADC10(122),   0, 255, 255, 180},
+	{"VIOLETA",    ADC10(253), ADC10(275), ADC10(338), 100,   0, 100, SERVO_KEEP},
+	{"BLANCO",     ADC10(110), ADC10(93),  ADC10(91),  255, 255, 255, SERVO_KEEP},
 };
 
 
 // USART
 uint8_t tx_buf[TX_BUF_SZ];
-uint8_t tx_head = 0, tx_tail = 0;
+volatile uint8_t tx_head = 0, tx_tail = 0;
 uint8_t rx_buf[RX_BUF_SZ];
-uint8_t rx_head = 0, rx_tail = 0;
+volatile uint8_t rx_head = 0, rx_tail = 0;
 
-// ADC
-uint16_t adc_result = 0;
-uint8_t  adc_done   = 0;
+// Calibracion: referencias en uso. Al arrancar se cargan de la EEPROM si
+// el bloque es valido; si no, quedan las de color_profiles.
+typedef struct {
+	uint8_t  version;
+	uint8_t  count;                  // NUM_COLORS al guardar
+	uint8_t  dark;                   // se calibro restando la luz ambiente
+	uint16_t rgb[NUM_COLORS][3];
+	uint16_t crc;                    // CRC-16 de todo lo anterior
+} CalBlock;
+
+CalBlock cal;
+CalBlock cal_ee EEMEM;
+uint8_t  cal_mode = 0;               // 1 = calibrando: no se clasifica
+uint8_t  cal_color = 0;              // referencia que se esta midiendo (1..NUM_COLORS, 0 = ninguna)
+uint8_t  cal_left = 0;               // vueltas que faltan
+uint32_t cal_sum[3];
+
+// Referencias en uso pasadas a cromaticidad (se recalculan al cambiar cal)
+typedef struct {
+	uint8_t  cr, cg;
+	uint16_t luma;
+} Chroma;
+
+Chroma cal_chroma[NUM_COLORS];
+
+uint8_t bin_mode = BIN_MODE;         // 1 = registros binarios en lugar de print_data
+
+// ADC: medicion sobremuestreada en curso (la lleva ADC_vect) y doble
+// buffer de resultados. La ISR escribe siempre el buffer que no es el
+// ultimo, asi que el lazo principal puede copiar adc_res[adc_last] sin cli.
+typedef struct {
+	uint16_t value;    // suma decimada, 10 + ADC_EXTRA_BITS bits
+	uint8_t  channel;
+	uint8_t  seq;      // numero de secuencia: cambia con cada resultado
+} AdcResult;
+
+volatile AdcResult adc_res[2];
+volatile uint8_t  adc_last = 0;      // buffer con el ultimo resultado
+volatile uint8_t  adc_seq  = 0;
+volatile uint16_t adc_sum  = 0;
+volatile uint8_t  adc_left = 0;      // conversiones que faltan (0 = libre)
+uint8_t adc_seen = 0;                // ultima secuencia leida
 
 // RGB LED
-uint8_t led_state = 0;
+uint8_t led_state = 0;               // fase de muestreo en curso (PHASE_*)
 uint16_t adc_sample[] = {0,0,0};
 
+// Muestreo: espera de cada fase (ms, configurable) y mediciones de la
+// vuelta en curso. Las vueltas completas salen por un doble buffer, igual
+// que los resultados del ADC.
+typedef struct {
+	uint16_t r, g, b;                // sin la luz ambiente si dark_frame
+	uint16_t dark;
+	uint8_t  seq;
+} RgbFrame;
+
+uint8_t settle_ms[4] = {SETTLE_MS, SETTLE_MS, SETTLE_MS, SETTLE_MS};
+uint8_t dark_frame = DARK_FRAME;
+volatile uint8_t  phase_wait = 0;    // ms que faltan para medir (0 = midiendo)
+volatile uint16_t phase_value[4];
+volatile RgbFrame frames[2];
+volatile uint8_t  frame_last = 0;
+volatile uint8_t  frame_seq  = 0;
+uint8_t frame_seen = 0;
+
+// Servo: la ISR del Timer1 lleva servo_pos hacia servo_target
+volatile uint16_t servo_target = 0;  // pulso pedido (0 = sin angulo todavia)
+uint16_t servo_pos = 0;              // pulso actual (solo la ISR)
+int16_t  servo_vel = 0;              // ticks por periodo, con signo (solo la ISR)
+uint8_t  servo_settle = 0;           // periodos de espera que faltan (solo la ISR)
+volatile uint8_t servo_ready = 1;    // llego al angulo pedido y se asento
+
+#if WS2812_SPI
+// Cada bit de la tira son 4 bits de SPI a 4 MHz (250 ns cada uno):
+// 0 = 1000 (250 ns alto), 1 = 1110 (750 ns alto), 1 us por bit.
+// Un byte de SPI lleva dos bits de la tira; el indice son esos dos bits.
+const uint8_t ws2812_code[4] = {0x88, 0x8E, 0xE8, 0xEE};
+#endif
+
+// Framebuffer de la tira, 3 bytes por pixel en el orden en que se envian
+// (G, B, R). ws2812_dirty_count es la cantidad de pixeles a reenviar:
+// hasta el ultimo que cambio desde el ultimo show.
+uint8_t  ws2812_fb[LED_COUNT * 3];
+uint8_t  ws2812_dirty_count = LED_COUNT;   // al arrancar se envia toda la tira
+
 
 // ------------------------------------------------------------------
 // HELPERS
@@ -121,7 +291,9 @@ uint8_t usart_rx_available(void) {
 }
 
 
-// Convierte un valor entero sin signo en un string
+#if FORMAT_BENCH
+// Conversion anterior (divide por 10 en cada digito), solo para comparar
+// con fmt_u16
 void UTOA(uint16_t value, char *buffer) { 
 	char temp[6];
 	int i = 0, j = 0;
@@ -142,6 +314,25 @@ void UTOA(uint16_t value, char *buffer) {
 	while (i > 0) buffer[j++] = temp[--i];
 	buffer[j] = '\0';
 }
+#endif
+
+#if WS2812_SPI
+
+// Envia un Byte a la tira de leds: cuatro bytes de SPI.
+// Solo espera a que el SPI termine el byte anterior (2 us) para cargar el
+// siguiente. Se llama con las interrupciones deshabilitadas (ver
+// ws2812_show): una interrupcion entre bytes alargaria el bajo del ultimo
+// bit en medio de un pixel.
+void send_byte(uint8_t byte) {
+	for (uint8_t i = 0; i < 4; i++) {
+		uint8_t c = ws2812_code[byte >> 6];
+		byte <<= 2;
+		while (!(SPSR & (1 << SPIF)));
+		SPDR = c;
+	}
+}
+
+#else
 
 // Envia un bit a la tira de LEDs
 // Usa asm volatile para tener un control preciso en los tiempos
@@ -180,7 +371,7 @@ void send_byte(uint8_t byte) {
 	sei();  // re-enable interrupts
 }
 
-
+#endif
 
 
 // ------------------------------------------------------------------
@@ -199,100 +390,123 @@ void usart_init(void) {
 
 void adc_init(void) {
 	ADMUX  = (1 << REFS0);                        
-	ADCSRA = (1 << ADEN)                          
+	ADCSRA = (1 << ADEN) | (1 << ADIE)            // Interrupcion al terminar
 	| (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0); // Prescaler 128
 }
 
 void rgb_init(void){
-	DDRB |= (1<<RED) | (1<<GREEN) | (1<<BLUE);
+	RGB_DDR |= (1<<RED) | (1<<GREEN) | (1<<BLUE);
 }
 
 
 void servo_init(void) {
-	SERVO_DDR |= (1 << SERVO_PORT); 
+	SERVO_DDR |= (1 << SERVO_PIN); 
 
 	TCCR1A = (1 << COM1A1) | (1 << WGM11);
 	TCCR1B = (1 << WGM13) | (1 << WGM12) | (1 << CS11); // 8
 
 	ICR1 = 39999;   
+	TIMSK1 = (1 << TOIE1);           // cada 20 ms: perfil del servo
 }
  
+// Timer2 en CTC a 1 ms: marca los tiempos del muestreo
+void sampler_init(void) {
+	TCCR2A = (1 << WGM21);
+	TCCR2B = (1 << CS22);            // 64
+	OCR2A  = 249;                    // 16 MHz / 64 / 250 = 1 kHz
+	TIMSK2 = (1 << OCIE2A);
+}
+
 void ws2812_init(void) { // tira de leds
 	LED_DDR |= (1 << LED_PIN);
+#if WS2812_SPI
+	// SPI maestro a F_CPU/4 = 4 MHz, MSB primero. SS (PB2) como salida para
+	// que no pase a esclavo; SCK (PB5) queda conmutando sin uso.
+	DDRB |= (1 << PORTB2) | (1 << PORTB5);
+	SPCR = (1 << SPE) | (1 << MSTR);
+	SPSR = 0;
+#endif
 }
 // ------------------------------------------------------------------
 // UTILITY
 // ------------------------------------------------------------------
 
-// Enviar pixel 
-void ws2812_send_pixel(uint8_t r, uint8_t g, uint8_t b) {
-	send_byte(g);
-	send_byte(b);
-	send_byte(r);
-}
+// Cambiar un pixel del framebuffer (se envia en el proximo show)
+void ws2812_set_pixel(uint16_t i, uint8_t r, uint8_t g, uint8_t b) {
+	if (i >= LED_COUNT) return;
 
-void ws2812_show(void) {
-	_delay_us(60);  // Tiempo de reset
+	uint8_t *p = &ws2812_fb[i * 3];
+	if (p[0] == g && p[1] == b && p[2] == r) return;
+	p[0] = g;
+	p[1] = b;
+	p[2] = r;
+	if (i >= ws2812_dirty_count) ws2812_dirty_count = i + 1;
 }
 
-
-// Encender n leds del mismo color
+// Poner los primeros n leds del mismo color
 void ws2812_fill(uint8_t r, uint8_t g, uint8_t b, uint16_t n) {
+	for (uint16_t i = 0; i < n; i++) {
+		ws2812_set_pixel(i, r, g, b);
+	}
+}
+
+// Enviar a la tira los pixeles hasta el ultimo que cambio; los que siguen
+// conservan su color. Si no cambio nada no se envia nada.
+// Con el SPI cada pixel (12 bytes, 24 us) sale sin interrupciones y las
+// pendientes se atienden entre pixel y pixel: el bajo entre pixeles dura
+// lo que tarden esas ISR una vez cada una. Se cuenta con el reset de la
+// hoja de datos del WS2812B (bajo de mas de 50 us, 800 ciclos): las ISR
+// juntas tienen que quedar bien por debajo. Las tiras que toman el reset
+// antes (algunas a los 6 us) no sirven con este programa.
+void ws2812_show(void) {
+	uint16_t n = ws2812_dirty_count * 3;
+
+	if (n == 0) return;
+#if WS2812_SPI
+	SPDR = 0;                               // 2 us en bajo: deja SPIF listo para send_byte
+	for (uint16_t i = 0; i < n; i += 3) {
+		uint8_t sreg = SREG;
+		cli();
+		send_byte(ws2812_fb[i]);
+		send_byte(ws2812_fb[i + 1]);
+		send_byte(ws2812_fb[i + 2]);
+		SREG = sreg;
+	}
+	while (!(SPSR & (1 << SPIF)));          // termina el ultimo byte
+#else
 	cli(); 
 	for (uint16_t i = 0; i < n; i++) {
-		ws2812_send_pixel(r, g, b);
+		send_byte(ws2812_fb[i]);
 	}
 	sei();
-	ws2812_show();
+#endif
+	ws2812_dirty_count = 0;
+	_delay_us(60);  // Tiempo de reset
 }
 
-// Mostrar colores especificos utilizando un switch
-void led_strip_set_color(uint8_t color_id) {
+// Mostrar en la tira el color de un perfil (fuera de la tabla = apagada)
+void led_strip_set_color(uint8_t color) {
 	uint8_t r = 0, g = 0, b = 0;
 
-	switch (color_id) {
-		case 1: // Rojo
-		r = 255; g = 0; b = 0;
-		break;
-
-		case 2: // Amarillo
-		r = 255; g = 100; b = 0;
-		break;
-
-		case 3: // Verde
-		r = 0; g = 255; b = 0;
-		break;
-
-		case 4: // Azul claro
-		r = 0; g = 255; b = 255;
-		break;
-
-		case 5: // Violeta
-		r = 100; g = 0; b = 100;
-		
-		break;
-
-		case 6: // Morado
-		r = 200; g = 0; b = 75;
-		
-		break;
-
-		case 7: // Blanco
-		r = 255; g = 255; b = 255;
-		break;
-
-		default: // Apagar LED
-		r = g = b = 0;
-		break;
+	if (color < NUM_COLORS) {
+		r = pgm_read_byte(&color_profiles[color].led_r);
+		g = pgm_read_byte(&color_profiles[color].led_g);
+		b = pgm_read_byte(&color_profiles[color].led_b);
 	}
-
-	ws2812_fill(r, g, b, 50);
+	ws2812_fill(r, g, b, LED_COUNT);
+	ws2812_show();
 }
 
-// Establecer angulo en el servomotor
+// Establecer angulo en el servomotor. No espera: el servo llega con el
+// perfil de TIMER1_OVF y entonces se levanta servo_ready
 void servo_set_angle(uint8_t angle) {
 	uint16_t pulse = 1000 + ((uint32_t)angle * 4000) / 180;
-	OCR1A = pulse;
+
+	if (pulse == servo_target) return;
+	cli();
+	servo_target = pulse;
+	servo_ready = 0;
+	sei();
 }
 
 // Escribir un byte al buffer de envio de USART
@@ -312,6 +526,48 @@ uint16_t usart_write_str(const char *s) {
 	return n;
 }
 
+// Escribir un string esperando lugar en el buffer (respuestas a comandos)
+void usart_write_str_wait(const char *s) {
+	while (*s) {
+		if (usart_write_try((uint8_t)*s)) s++;
+	}
+}
+
+// Salida de fmt_printf_P: espera lugar en el buffer. print_data solo se
+// llama si la linea entra, asi que ahi nunca espera
+void fmt_escribir(const char *d, uint8_t n) {
+	while (n) {
+		if (usart_write_try((uint8_t)*d)) {
+			d++;
+			n--;
+		}
+	}
+}
+
+// Retorna 1 si hay una linea completa en el buffer de RX (o si esta lleno)
+uint8_t usart_rx_line(void) {
+	uint8_t end = rx_head;
+	if (((end - rx_tail) & RX_MASK) == RX_MASK) return 1;
+	for (uint8_t i = rx_tail; i != end; i = (uint8_t)((i + 1) & RX_MASK)) {
+		if (rx_buf[i] == '\n' || rx_buf[i] == '\r') return 1;
+	}
+	return 0;
+}
+
+// Cambiar la velocidad de la UART. Primero sale lo que quedaba en el
+// buffer, que era para la velocidad anterior, hasta el ultimo bit: la ISR
+// baja TXC0 antes de cada escritura, asi que TXC0 se levanta cuando el
+// ultimo byte salio del registro de desplazamiento (siempre se llama
+// despues de haber mandado algo)
+void usart_set_baud(uint32_t baud) {
+	uint16_t ubrr = (uint16_t)((F_CPU + 8 * baud) / (16 * baud) - 1);
+
+	while (tx_head != tx_tail || (UCSR0B & (1 << UDRIE0)));
+	while ((UCSR0A & ((1 << UDRE0) | (1 << TXC0))) != ((1 << UDRE0) | (1 << TXC0)));
+	UBRR0H = ubrr >> 8;
+	UBRR0L = ubrr;
+}
+
 // Leer byte del buffer de recepcion de usart
 uint8_t usart_read_try(uint8_t *b) {
 	if (rx_head == rx_tail) return 0;                 // empty
@@ -336,155 +592,513 @@ uint8_t usart_read_str(char *dest, uint8_t max_len) {
 	return count;
 }
 
-// Leer adc
-uint16_t adc_read(uint8_t channel) {
+// Arrancar una medicion sobremuestreada del canal (no espera)
+void adc_start(uint8_t channel) {
 	ADMUX = (ADMUX & 0xF0) | (channel & 0x0F);  
+	adc_seen = adc_seq;                         // lo anterior ya no interesa
+	adc_sum = 0;
+	adc_left = ADC_OVERSAMPLE;
 	ADCSRA |= (1 << ADSC);                     
-	while (ADCSRA & (1 << ADSC));               // Wait for conversion to finish
-	return ADC;                                 
+}
+
+// Copiar el ultimo resultado. Retorna 1 si es nuevo (no leido antes)
+uint8_t adc_get(AdcResult *res) {
+	uint8_t i;
+	do {
+		i = adc_last;
+		res->value   = adc_res[i].value;
+		res->channel = adc_res[i].channel;
+		res->seq     = adc_res[i].seq;
+	} while (i != adc_last);                    // llego otro resultado durante la copia
+
+	if (res->seq == adc_seen) return 0;
+	adc_seen = res->seq;
+	return 1;
+}
+
+// Dormir hasta la proxima interrupcion si no hay nada que hacer: ni una
+// vuelta nueva ni una linea recibida. En idle siguen el Timer2, la UART y
+// el PWM del servo. Con ADC_SLEEP, si se esta midiendo y no sale nada por
+// la UART, se duerme en reduccion de ruido y despierta el ADC_vect de
+// cada conversion.
+void main_sleep(void) {
+	cli();
+	if (frame_seq != frame_seen || usart_rx_line()) {
+		sei();
+		return;
+	}
+#if ADC_SLEEP
+	if (adc_left && tx_head == tx_tail && !(UCSR0B & (1 << UDRIE0)) && (UCSR0A & (1 << TXC0))) {
+		set_sleep_mode(SLEEP_MODE_ADC);
+	}
+	else {
+		set_sleep_mode(SLEEP_MODE_IDLE);
+	}
+#else
+	set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
+	sleep_enable();
+	sei();                                      // sleep_cpu se ejecuta antes de cualquier ISR
+	sleep_cpu();
+	sleep_disable();
 }
 
 // Establecer color del led rgb (iluminador)
 void rgb_set(uint8_t r, uint8_t g, uint8_t b) {
-	PORTB = (PORTB & ~((1 << RED)|(1 << GREEN)|(1 << BLUE))) |
+	RGB_PORT = (RGB_PORT & ~((1 << RED)|(1 << GREEN)|(1 << BLUE))) |
 	((r<<RED) | (g<<GREEN) | (b<<BLUE));
 }
 
+// Cromaticidad de una referencia (dos divisiones; se hace una sola vez
+// al cambiar la calibracion). Las lecturas no se convierten: ver
+// identify_color
+void chroma_of(uint16_t r, uint16_t g, uint16_t b, Chroma *c) {
+	uint16_t sum = r + g + b;                    // <= 3 * 4095
+
+	if (sum == 0) {
+		c->cr = c->cg = 85;
+		c->luma = 0;
+		return;
+	}
+	c->cr = (uint8_t)(((uint32_t)r * 255 + sum / 2) / sum);
+	c->cg = (uint8_t)(((uint32_t)g * 255 + sum / 2) / sum);
+	c->luma = sum >> LUMA_SHIFT;
+}
+
+// Recalcular la cromaticidad de las referencias en uso
+void chroma_update(void) {
+	for (uint8_t i = 0; i < NUM_COLORS; i++) {
+		chroma_of(cal.rgb[i][0], cal.rgb[i][1], cal.rgb[i][2], &cal_chroma[i]);
+	}
+}
+
 // Identificar color a partir de valores rgb.
-// Tomando cada valor calibrado como un vector, se determina la distancia
-// cartesiana del vector leido por el sensor.
-const char* identify_color(uint16_t r, uint16_t g, uint16_t b) {
+// Solo cuentan las referencias a menos de CHROMA_RADIUS en cromaticidad;
+// entre esas gana la mas cercana sumando el brillo. Sin dividir: con
+// sum = r + g + b, la diferencia de cromaticidad en r es
+// (r * 255 - cr * sum) / sum, asi que se compara r * 255 - cr * sum
+// contra CHROMA_RADIUS * sum (y lo mismo en g). Las que pasan se ordenan
+// por la distancia multiplicada por sum^2 (igual para todas), con todo
+// corrido s bits para que los cuadrados entren en 32 bits.
+// Retorna el indice del perfil o COLOR_UNKNOWN (tambien si no hay luz).
+uint8_t identify_color(uint16_t r, uint16_t g, uint16_t b) {
+	uint16_t sum = r + g + b;                    // <= 3 * 4095
+	uint32_t lim = (uint32_t)CHROMA_RADIUS * sum;
+	uint32_t r255 = (uint32_t)r * 255;
+	uint32_t g255 = (uint32_t)g * 255;
+	uint16_t luma = sum >> LUMA_SHIFT;
+	uint32_t best_dist = 0xFFFFFFFF;
+	uint8_t best = COLOR_UNKNOWN;
+	uint8_t s = 0;
+
+	if (sum == 0) return COLOR_UNKNOWN;
+	while ((lim >> s) >= 4096) s++;             // lim >> s de 12 bits
+	uint16_t lim_s = (uint16_t)(lim >> s);
+	uint32_t lim2 = (uint32_t)lim_s * lim_s;
+	uint8_t sum_s = (uint8_t)(sum >> s);         // < 4096 / CHROMA_RADIUS
+
+	for (uint8_t i = 0; i < NUM_COLORS; i++) {
+		uint32_t ref_r = (uint32_t)cal_chroma[i].cr * sum;
+		uint32_t ref_g = (uint32_t)cal_chroma[i].cg * sum;
+		uint32_t er = (r255 > ref_r) ? r255 - ref_r : ref_r - r255;
+		uint32_t eg = (g255 > ref_g) ? g255 - ref_g : ref_g - g255;
+		if (er >= lim || eg >= lim) continue;
+
+		uint16_t er_s = (uint16_t)(er >> s);
+		uint16_t eg_s = (uint16_t)(eg >> s);
+		uint32_t dist = (uint32_t)er_s * er_s + (uint32_t)eg_s * eg_s;
+		if (dist >= lim2) continue;
+
+		int16_t dl = (int16_t)luma - (int16_t)cal_chroma[i].luma;
+		if (dl < 0) dl = -dl;
+		if (dl > 255) dl = 255;
+		uint16_t l = (uint8_t)dl * sum_s;         // brillo en la misma escala
+		dist += ((uint32_t)l * l) >> LUMA_W_SHIFT;
+		if (dist < best_dist) {
+			best_dist = dist;
+			best = i;
+		}
+	}
+	return best;
+}
+
+#if CLASSIFY_BENCH
+// Clasificador anterior, solo para comparar: tomando cada valor calibrado
+// como un vector, se determina la distancia cartesiana del vector leido
+// por el sensor.
+uint8_t identify_color_rgb(uint16_t r, uint16_t g, uint16_t b) {
 	uint32_t best_dist = 0xFFFFFFFF;
-	const char *best_name = "UNKNOWN";
+	uint8_t best = 0;
 
 	
 	for (uint8_t i = 0; i < NUM_COLORS; i++) {
 		// Diferencia  =  medido - calibrado
-		int32_t dr = (int32_t)r - color_refs[i].r;
-		int32_t dg = (int32_t)g - color_refs[i].g;
-		int32_t db = (int32_t)b - color_refs[i].b;
+		int32_t dr = (int32_t)r - cal.rgb[i][0];
+		int32_t dg = (int32_t)g - cal.rgb[i][1];
+		int32_t db = (int32_t)b - cal.rgb[i][2];
 		uint32_t dist = dr*dr + dg*dg + db*db;
 		// Cuadrado de distancia cartesiana
 		
 		// Encontrar la menor distancia
 		if (dist < best_dist) {
 			best_dist = dist;
-			best_name = color_refs[i].name;
+			best = i;
 		}
 	}
-	return best_name;
+	return best;
 }
+#endif
 
 // Imprimir datos parseados por usart
-void print_data(const char *color_name) {
-	char buf[10];
+void print_data(uint8_t color) {
+	if (color == COLOR_UNKNOWN) {
+		fmt_printf_P(PSTR("Fotocelda: %u %u %u  Color detectado: DESCONOCIDO\r\n"),
+		             adc_sample[0], adc_sample[1], adc_sample[2]);
+		return;
+	}
+
+	// Delta
+	int16_t dR = (int16_t)adc_sample[0] - cal.rgb[color][0];
+	int16_t dG = (int16_t)adc_sample[1] - cal.rgb[color][1];
+	int16_t dB = (int16_t)adc_sample[2] - cal.rgb[color][2];
+
+	fmt_printf_P(PSTR("Fotocelda: %u %u %u  Color detectado: %S"
+	                  "  Valor establecido: [%u,%u,%u]  Delta: [%+d,%+d,%+d]\r\n"),
+	             adc_sample[0], adc_sample[1], adc_sample[2], color_profiles[color].name,
+	             cal.rgb[color][0], cal.rgb[color][1], cal.rgb[color][2], dR, dG, dB);
+}
+
+
+// Arrancar una fase: prender el iluminador que corresponde y esperar
+void phase_begin(uint8_t phase) {
+	led_state = phase;
+	rgb_set(phase == PHASE_RED, phase == PHASE_GREEN, phase == PHASE_BLUE);
+	phase_wait = settle_ms[phase] ? settle_ms[phase] : 1;
+}
+
+// Publicar la vuelta completa en el buffer que no es el ultimo
+void frame_publish(void) {
+	uint16_t d = dark_frame ? phase_value[PHASE_DARK] : 0;
+	uint8_t i = frame_last ^ 1;
+
+	frames[i].r = (phase_value[PHASE_RED]   > d) ? phase_value[PHASE_RED]   - d : 0;
+	frames[i].g = (phase_value[PHASE_GREEN] > d) ? phase_value[PHASE_GREEN] - d : 0;
+	frames[i].b = (phase_value[PHASE_BLUE]  > d) ? phase_value[PHASE_BLUE]  - d : 0;
+	frames[i].dark = d;
+	frames[i].seq = ++frame_seq;
+	frame_last = i;
+}
 
-	// Find by name
-	uint16_t ref_r = 0, ref_g = 0, ref_b = 0;
+// Copiar la ultima vuelta completa. Retorna 1 si es nueva
+uint8_t frame_get(RgbFrame *f) {
+	uint8_t i;
+	do {
+		i = frame_last;
+		f->r    = frames[i].r;
+		f->g    = frames[i].g;
+		f->b    = frames[i].b;
+		f->dark = frames[i].dark;
+		f->seq  = frames[i].seq;
+	} while (i != frame_last);
+
+	if (f->seq == frame_seen) return 0;
+	frame_seen = f->seq;
+	return 1;
+}
+
+// Lugares libres en el buffer de envio de USART
+uint8_t usart_tx_free(void) {
+	return (uint8_t)(TX_MASK - ((tx_head - tx_tail) & TX_MASK));
+}
+
+// CRC-16 del bloque de calibracion, sin el propio CRC
+uint16_t cal_crc(const CalBlock *c) {
+	const uint8_t *p = (const uint8_t *)c;
+	uint16_t crc = 0xFFFF;
+	for (uint8_t i = 0; i < offsetof(CalBlock, crc); i++) {
+		crc = _crc16_update(crc, p[i]);
+	}
+	return crc;
+}
+
+// Referencias de fabrica
+void cal_defaults(void) {
 	for (uint8_t i = 0; i < NUM_COLORS; i++) {
-		if (strcmp(color_name, color_refs[i].name) == 0) {
-			ref_r = color_refs[i].r;
-			ref_g = color_refs[i].g;
-			ref_b = color_refs[i].b;
-			break;
-		}
+		cal.rgb[i][0] = pgm_read_word(&color_profiles[i].r);
+		cal.rgb[i][1] = pgm_read_word(&color_profiles[i].g);
+		cal.rgb[i][2] = pgm_read_word(&color_profiles[i].b);
 	}
+	cal.dark = dark_frame;
+	chroma_update();
+}
 
-	// Delta
-	int16_t dR = (int16_t)adc_sample[0] - ref_r;
-	int16_t dG = (int16_t)adc_sample[1] - ref_g;
-	int16_t dB = (int16_t)adc_sample[2] - ref_b;
+// Cargar la calibracion de la EEPROM. Retorna 0 si no hay una valida
+// (EEPROM borrada, otra version o CRC malo): quedan las de fabrica
+uint8_t cal_load(void) {
+	eeprom_read_block(&cal, &cal_ee, sizeof(cal));
+	if (cal.version != CAL_VERSION || cal.count != NUM_COLORS || cal.crc != cal_crc(&cal)) {
+		cal_defaults();
+		return 0;
+	}
+	dark_frame = cal.dark;
+	chroma_update();
+	return 1;
+}
 
-	// Printing
-	usart_write_str("Fotocelda: ");
-	UTOA(adc_sample[0], buf); usart_write_str(buf);
-	usart_write_str(" ");
-	UTOA(adc_sample[1], buf); usart_write_str(buf);
-	usart_write_str(" ");
-	UTOA(adc_sample[2], buf); usart_write_str(buf);
+// Guardar la calibracion en uso (solo se escriben los bytes que cambiaron)
+void cal_save(void) {
+	cal.version = CAL_VERSION;
+	cal.count = NUM_COLORS;
+	cal.dark = dark_frame;
+	cal.crc = cal_crc(&cal);
+	eeprom_update_block(&cal, &cal_ee, sizeof(cal));
+}
 
-	usart_write_str("  Color detectado: ");
-	usart_write_str(color_name);
+// Imprimir una referencia: "n NOMBRE r g b"
+void cal_print(uint8_t i) {
+	fmt_printf_P(PSTR("%u %S %u %u %u\r\n"), i + 1, color_profiles[i].name,
+	             cal.rgb[i][0], cal.rgb[i][1], cal.rgb[i][2]);
+}
 
-	usart_write_str("  Valor establecido: [");
-	UTOA(ref_r, buf); usart_write_str(buf); usart_write_str(",");
-	UTOA(ref_g, buf); usart_write_str(buf); usart_write_str(",");
-	UTOA(ref_b, buf); usart_write_str(buf); usart_write_str("]");
+// Sumar una vuelta a la referencia que se esta midiendo
+void cal_frame(const RgbFrame *f) {
+	if (cal_color == 0) return;
 
-	usart_write_str("  Delta: [");
-	if (dR >= 0) usart_write_str("+");
-	else usart_write_str("-");
-	UTOA((dR >= 0) ? dR : -dR, buf); usart_write_str(buf);
-	usart_write_str(",");
+	// La primera vuelta pudo haber empezado antes del comando
+	if (cal_left-- <= CAL_FRAMES) {
+		cal_sum[0] += f->r;
+		cal_sum[1] += f->g;
+		cal_sum[2] += f->b;
+	}
+	if (cal_left) return;
 
-	if (dG >= 0) usart_write_str("+");
-	else usart_write_str("-");
-	UTOA((dG >= 0) ? dG : -dG, buf); usart_write_str(buf);
-	usart_write_str(",");
+	uint8_t i = cal_color - 1;
+	for (uint8_t k = 0; k < 3; k++) {
+		cal.rgb[i][k] = (uint16_t)((cal_sum[k] + CAL_FRAMES / 2) / CAL_FRAMES);
+	}
+	cal_color = 0;
+	chroma_update();
+	cal_print(i);
+}
 
-	if (dB >= 0) usart_write_str("+");
-	else usart_write_str("-");
-	UTOA((dB >= 0) ? dB : -dB, buf); usart_write_str(buf);
-	usart_write_str("]\r\n");
+#if CLASSIFY_BENCH || FORMAT_BENCH
+// Ticks de Timer1 desde t0 (F_CPU/8: 8 ciclos cada uno). El Timer1 es el
+// del servo y vuelve a 0 despues de ICR1
+uint16_t bench_since(uint16_t t0) {
+	uint16_t t = TCNT1;
+	return (t >= t0) ? t - t0 : t + ICR1 + 1 - t0;
 }
+#endif
 
+#if CLASSIFY_BENCH
 
-void rgb_read(void){
-	char buffer[8];
-		
-	switch(led_state){
-		case 0:
-		rgb_set(1,0,0);
-		adc_sample[0] = adc_read(0); // Rojo
-
-		UTOA(adc_sample[0], buffer);
-		break;
-		case 1:
-		rgb_set(0,1,0);
-		adc_sample[1] = adc_read(0); // Verde
-
-		UTOA(adc_sample[1], buffer);
-		break;
-		case 2:
-		rgb_set(0,0,1);
-		adc_sample[2] = adc_read(0); // Azul
-
-		UTOA(adc_sample[2], buffer);
-		
-		const char *color_name = identify_color(adc_sample[0], adc_sample[1], adc_sample[2]);
-		print_data(color_name);
-		
-		if (strcmp(color_name, "ROJO") == 0) {
-			led_strip_set_color(1);
-			servo_set_angle(0);
-		}
-		else if (strcmp(color_name, "AMARILLO") == 0) {
-			led_strip_set_color(2);
-			servo_set_angle(60);
-		}
-		else if (strcmp(color_name, "VERDE") == 0) {
-			led_strip_set_color(3);
-			servo_set_angle(120);
+// Ticks de una clasificacion, sin interrupciones en el medio
+uint16_t bench_call(uint8_t (*classify)(uint16_t, uint16_t, uint16_t),
+                    const uint16_t *rgb, uint8_t *color) {
+	cli();
+	uint16_t t0 = TCNT1;
+	*color = classify(rgb[0], rgb[1], rgb[2]);
+	uint16_t ticks = bench_since(t0);
+	sei();
+	return ticks;
+}
+
+// Comparar los dos clasificadores sobre las referencias en uso: ciclos
+// promedio por llamada (resolucion 8 ciclos) y en cuantas coinciden
+void classify_bench(void) {
+	uint32_t t_rgb = 0, t_chroma = 0;
+	uint8_t same = 0;
+
+	for (uint8_t i = 0; i < NUM_COLORS; i++) {
+		uint8_t c_rgb, c_chroma;
+		t_rgb    += bench_call(identify_color_rgb, cal.rgb[i], &c_rgb);
+		t_chroma += bench_call(identify_color, cal.rgb[i], &c_chroma);
+		if (c_rgb == c_chroma) same++;
+	}
+
+	fmt_printf_P(PSTR("Ciclos RGB: %lu  cromaticidad: %lu  coinciden: %u/%u\r\n"),
+	             (uint32_t)(t_rgb * 8 / NUM_COLORS), (uint32_t)(t_chroma * 8 / NUM_COLORS),
+	             same, (uint16_t)NUM_COLORS);
+}
+#endif
+
+#if FORMAT_BENCH
+// Ciclos promedio de UTOA, utoa (avr-libc) y fmt_u16 sobre numeros de 1 a
+// 5 cifras (resolucion 8 ciclos)
+void format_bench(void) {
+	static const uint16_t values[] = {7, 42, 864, 4095, 65535};
+	uint32_t t[3] = {0, 0, 0};
+	char buf[8];
+	uint16_t t0;
+
+	for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		cli(); t0 = TCNT1; UTOA(values[i], buf);       t[0] += bench_since(t0); sei();
+		cli(); t0 = TCNT1; utoa(values[i], buf, 10);   t[1] += bench_since(t0); sei();
+		cli(); t0 = TCNT1; fmt_u16(buf, values[i]);    t[2] += bench_since(t0); sei();
+	}
+	for (uint8_t k = 0; k < 3; k++) {
+		t[k] = t[k] * 8 / (sizeof(values) / sizeof(values[0]));
+	}
+	fmt_printf_P(PSTR("Ciclos UTOA: %lu  utoa: %lu  fmt_u16: %lu\r\n"), t[0], t[1], t[2]);
+}
+#endif
+
+// Comandos por UART, una linea cada uno:
+//   cal    entrar al modo calibracion (se deja de clasificar)
+//   bin    registros binarios a BAUD_BIN (la respuesta sale a BAUD_RATE)
+//   txt    volver al texto a BAUD_RATE (se manda a BAUD_BIN)
+// y ya calibrando:
+//   1..N   medir la referencia N con la hoja puesta bajo el sensor
+//   l      listar las referencias en uso
+//   g      guardar en la EEPROM
+//   f      volver a las de fabrica (sin guardar)
+//   s      salir; lo medido se usa aunque no se haya guardado
+//   b      ciclos de los clasificadores (CLASSIFY_BENCH) y de la
+//          conversion a texto (FORMAT_BENCH)
+void command_read(void) {
+	char cmd[CMD_MAX];
+
+	if (!usart_rx_line()) return;
+	if (usart_read_str(cmd, sizeof(cmd)) == 0) return;     // el \n de un \r\n
+
+	if (!cal_mode) {
+		if (strcmp(cmd, "cal") == 0) {
+			cal_mode = 1;
+			usart_write_str_wait("Calibracion: n medir la referencia n, l lista, g guardar, f fabrica, s salir\r\n");
+			for (uint8_t i = 0; i < NUM_COLORS; i++) cal_print(i);
 		}
-		else if (strcmp(color_name, "AZUL CLARO") == 0) {
-			led_strip_set_color(4);
-			servo_set_angle(180);
+		else if (strcmp(cmd, "bin") == 0 && !bin_mode) {
+			usart_write_str_wait("Binario\r\n");
+			usart_set_baud(BAUD_BIN);
+			bin_mode = 1;
 		}
-		else if (strcmp(color_name, "VIOLETA") == 0) {
-			led_strip_set_color(5);
+		else if (strcmp(cmd, "txt") == 0 && bin_mode) {
+			usart_set_baud(BAUD_RATE);
+			bin_mode = 0;
+			usart_write_str_wait("Texto\r\n");
 		}
-		else if (strcmp(color_name, "MORADO") == 0) {
-			led_strip_set_color(6);
+		return;
+	}
+
+	uint8_t n = (uint8_t)atoi(cmd);
+	if (n >= 1 && n <= NUM_COLORS) {
+		cal_sum[0] = cal_sum[1] = cal_sum[2] = 0;
+		cal_left = CAL_FRAMES + 1;
+		cal_color = n;
+	}
+	else if (strcmp(cmd, "l") == 0) {
+		for (uint8_t i = 0; i < NUM_COLORS; i++) cal_print(i);
+	}
+	else if (strcmp(cmd, "g") == 0) {
+		cal_save();
+		usart_write_str_wait("Guardado\r\n");
+	}
+	else if (strcmp(cmd, "f") == 0) {
+		cal_defaults();
+		for (uint8_t i = 0; i < NUM_COLORS; i++) cal_print(i);
+	}
+	else if (strcmp(cmd, "s") == 0) {
+		cal_mode = 0;
+		cal_color = 0;
+	}
+#if CLASSIFY_BENCH || FORMAT_BENCH
+	else if (strcmp(cmd, "b") == 0) {
+#if CLASSIFY_BENCH
+		classify_bench();
+#endif
+#if FORMAT_BENCH
+		format_bench();
+#endif
+	}
+#endif
+	else {
+		usart_write_str_wait("?\r\n");
+	}
+}
+
+// COBS: reemplaza los 0 de los datos para que el 0 solo marque el fin del
+// registro. n < 254; out necesita n + 2 bytes (con el 0 final)
+uint8_t cobs_encode(const uint8_t *in, uint8_t n, uint8_t *out) {
+	uint8_t code_i = 0, code = 1, o = 1;
+
+	for (uint8_t i = 0; i < n; i++) {
+		if (in[i] == 0) {
+			out[code_i] = code;
+			code_i = o++;
+			code = 1;
 		}
-		else if (strcmp(color_name, "BLANCO") == 0) {
-			led_strip_set_color(7);
+		else {
+			out[o++] = in[i];
+			code++;
 		}
-	
-		break;
 	}
+	out[code_i] = code;
+	out[o++] = 0;
+	return o;
+}
 
-	led_state = (led_state+1) % 3;
-	
+// Registro binario de una vuelta (little endian, 19 bytes con COBS):
+//   [REC_RGB] [seq] [r] [g] [b] [color] [dR] [dG] [dB] [CRC-16]
+// r, g, b sin signo y deltas con signo de 16 bits; color = indice del
+// perfil o COLOR_UNKNOWN (deltas en 0). seq es el de la vuelta: si falta
+// alguno, el host sabe que se perdio. Sale entero o no sale.
+void bin_record(const RgbFrame *f, uint8_t color) {
+	uint8_t rec[REC_LEN + 2];
+	uint8_t out[REC_LEN + 4];
+	uint16_t v[3] = {f->r, f->g, f->b};
+	uint16_t crc = 0xFFFF;
+	uint8_t n = 0;
+
+	rec[n++] = REC_RGB;
+	rec[n++] = f->seq;
+	for (uint8_t k = 0; k < 3; k++) {
+		rec[n++] = v[k] & 0xFF;
+		rec[n++] = v[k] >> 8;
+	}
+	rec[n++] = color;
+	for (uint8_t k = 0; k < 3; k++) {
+		int16_t d = (color == COLOR_UNKNOWN) ? 0 : (int16_t)v[k] - (int16_t)cal.rgb[color][k];
+		rec[n++] = (uint16_t)d & 0xFF;
+		rec[n++] = (uint16_t)d >> 8;
+	}
+	for (uint8_t i = 0; i < n; i++) {
+		crc = _crc16_update(crc, rec[i]);
+	}
+	rec[n++] = crc & 0xFF;
+	rec[n++] = crc >> 8;
+
+	n = cobs_encode(rec, n, out);
+	if (usart_tx_free() < n) return;
+	for (uint8_t i = 0; i < n; i++) {
+		usart_write_try(out[i]);
+	}
+}
+
+// Procesar la ultima vuelta completa. El muestreo sigue por interrupciones,
+// asi que la siguiente se mide mientras esta se clasifica y se imprime.
+void rgb_read(void){
+	RgbFrame f;
+
+	if (!frame_get(&f)) return;
+	adc_sample[0] = f.r;
+	adc_sample[1] = f.g;
+	adc_sample[2] = f.b;
+
+	if (cal_mode) {
+		cal_frame(&f);
+		return;
+	}
+
+	uint8_t color = identify_color(adc_sample[0], adc_sample[1], adc_sample[2]);
+	// Si la UART no llego a sacar la linea anterior, esta no se imprime
+	// (mejor saltear una linea que mandarla cortada)
+	if (bin_mode) bin_record(&f, color);
+	else if (usart_tx_free() >= PRINT_MAX) print_data(color);
+
+	led_strip_set_color(color);                 // desconocido: tira apagada
+	if (color == COLOR_UNKNOWN) return;         // el servo se queda donde esta
+	uint8_t angle = pgm_read_byte(&color_profiles[color].angle);
+	if (angle != SERVO_KEEP) servo_set_angle(angle);
 }
 
 
@@ -501,13 +1115,17 @@ int main(void) {
 	adc_init();
 	rgb_init();
 	servo_init();
+	sampler_init();
+	uint8_t cal_ok = cal_load();                // puede cambiar dark_frame
+	phase_begin(dark_frame ? PHASE_DARK : PHASE_RED);
 	sei();
+	usart_write_str(cal_ok ? "Calibracion: EEPROM\r\n" : "Calibracion: fabrica\r\n");
+	if (bin_mode) usart_set_baud(BAUD_BIN);
 	
 	while (1) {
+		command_read();
 		rgb_read();
-		_delay_ms(50);
-
-	
+		main_sleep();
 	}
 }
 
@@ -517,12 +1135,107 @@ int main(void) {
 // ------------------------------------------------------------------
 
 
+// Cada 1 ms: espera de la fase en curso y, medida la fase, pasa a la siguiente
+ISR(TIMER2_COMPA_vect) {
+	AdcResult res;
+
+	if (phase_wait) {
+#if SERVO_HOLD
+		if (phase_wait == 1 && !servo_ready) return;   // medir con el servo quieto
+#endif
+		if (--phase_wait == 0) adc_start(0);
+		return;
+	}
+	if (!adc_get(&res)) return;                 // todavia midiendo
+
+	phase_value[led_state] = res.value;
+	if (led_state == PHASE_BLUE) {
+		frame_publish();
+		phase_begin(dark_frame ? PHASE_DARK : PHASE_RED);
+	}
+	else {
+		phase_begin(led_state + 1);
+	}
+}
+
+// Cada 20 ms (TOP del PWM; OCR1A se actualiza en el periodo siguiente):
+// un paso del perfil del servo. La velocidad cambia de a SERVO_ACCEL y es
+// la mayor que todavia deja frenar antes del objetivo: a velocidad k*A se
+// recorren A*k*(k+1)/2 ticks hasta parar. Si el objetivo cambia en el
+// medio del movimiento, primero frena.
+ISR(TIMER1_OVF_vect) {
+	uint16_t target = servo_target;
+	int16_t d, v;
+	uint8_t neg, arrive = 0;
+
+	if (target == 0) return;
+	if (servo_pos == 0) {
+		servo_pos = target;
+		servo_settle = SERVO_SETTLE_FIRST;
+		OCR1A = servo_pos;
+		return;
+	}
+	if (servo_pos == target && servo_vel == 0) {
+		if (servo_settle && --servo_settle == 0) servo_ready = 1;
+		return;
+	}
+
+	// Distancia y velocidad en la direccion del objetivo
+	d = (int16_t)target - (int16_t)servo_pos;
+	v = servo_vel;
+	neg = (d < 0);
+	if (neg) {
+		d = -d;
+		v = -v;
+	}
+
+	uint32_t brake = 2UL * SERVO_ACCEL * d;      // comparado con v * (v + A)
+	if (v < 0) {
+		v += SERVO_ACCEL;                           // se alejaba: frenar
+	}
+	else if (v + SERVO_ACCEL <= SERVO_VMAX &&
+	         (uint32_t)(v + SERVO_ACCEL) * (v + 2 * SERVO_ACCEL) <= brake) {
+		v += SERVO_ACCEL;
+	}
+	else if ((uint32_t)v * (v + SERVO_ACCEL) > brake) {
+		v -= SERVO_ACCEL;
+	}
+	if (v >= 0 && v <= SERVO_ACCEL && d <= SERVO_ACCEL) {   // llega en este periodo
+		v = d;
+		arrive = 1;
+	}
+
+	servo_pos += neg ? -v : v;
+	servo_vel = arrive ? 0 : (neg ? -v : v);
+	if (arrive) servo_settle = SERVO_SETTLE;
+	OCR1A = servo_pos;
+}
+
+// Fin de conversion: acumula y, con todas las muestras, decima al doble buffer
+ISR(ADC_vect) {
+	uint16_t v = ADC;
+
+	if (adc_left == 0) return;                  // conversion sin medicion pedida
+	adc_sum += v;
+	if (--adc_left) {
+		ADCSRA |= (1 << ADSC);                  // siguiente muestra
+		return;
+	}
+
+	uint8_t i = adc_last ^ 1;
+	adc_res[i].value   = (adc_sum + (1 << (ADC_EXTRA_BITS - 1))) >> ADC_EXTRA_BITS;
+	adc_res[i].channel = ADMUX & 0x0F;
+	adc_res[i].seq     = ++adc_seq;
+	adc_last = i;
+}
+
 // Interrupcion de registro en enviado libre
 ISR(USART_UDRE_vect) {
 	if (tx_head == tx_tail) {
 		UCSR0B &= (uint8_t)~(1<<UDRIE0);
 		return;
 	}
+	UCSR0A = (UCSR0A & ((1 << U2X0) | (1 << MPCM0))) | (1 << TXC0);   // TXC0 se borra con 1
 	UDR0 = tx_buf[tx_tail];
 	tx_tail = (uint8_t)((tx_tail + 1) & TX_MASK);
 }
@@ -0,0 +1,173 @@
+"""
+colores_bin.py
+
+Graba a CSV los registros binarios del selector de colores.
+
+El micro, en modo binario (comando "bin" o BIN_MODE 1 en main.c), manda
+por cada vuelta del muestreo un registro COBS terminado en 0:
+
+  [1] [seq] [r L H] [g L H] [b L H] [color] [dR L H] [dG L H] [dB L H] [CRC L H]
+
+r, g, b sin signo, deltas con signo (contra la referencia del color),
+color = indice en color_profiles o 255 si es desconocido, CRC-16 (0xA001,
+inicio 0xFFFF, el de _crc16_update de avr-libc) de los 15 bytes
+anteriores. seq cuenta las vueltas: los que faltan se perdieron (el micro
+no llego a mandarlos) y van en la columna "perdidos".
+
+Los registros con CRC malo se descartan y se cuentan; entre ellos caen
+las respuestas de texto a los comandos.
+
+Uso:
+    python colores_bin.py COM5 -o medidas.csv --bin
+    python colores_bin.py /dev/ttyUSB0 -b 500000 -o medidas.csv
+    python colores_bin.py captura.bin -o medidas.csv
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+import time
+
+# Mismo orden que color_profiles en main.c
+COLORES = ['MORADO', 'ROJO', 'AMARILLO', 'VERDE', 'AZUL CLARO', 'VIOLETA', 'BLANCO']
+DESCONOCIDO = 255
+REC_RGB = 1
+REGISTRO = struct.Struct('<BBHHHBhhhH')
+BAUD_TEXTO = 9600
+
+
+def crc16(datos):
+    crc = 0xFFFF
+    for b in datos:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def cobs_decodificar(datos):
+    """Devuelve los bytes originales o None si el bloque esta mal formado."""
+    salida = bytearray()
+    i = 0
+    while i < len(datos):
+        codigo = datos[i]
+        if codigo == 0 or i + codigo > len(datos) + 1:
+            return None
+        salida += datos[i + 1:i + codigo]
+        i += codigo
+        if codigo < 0xFF and i < len(datos):
+            salida.append(0)
+    return bytes(salida)
+
+
+def registro(bloque):
+    """Registro decodificado como tupla, o None si el CRC o el largo no dan."""
+    datos = cobs_decodificar(bloque)
+    if datos is None or len(datos) != REGISTRO.size:
+        return None
+    campos = REGISTRO.unpack(datos)
+    if campos[0] != REC_RGB or campos[-1] != crc16(datos[:-2]):
+        return None
+    return campos[1:-1]
+
+
+class Lector:
+    """Separa el flujo en bloques terminados en 0 y los decodifica."""
+
+    def __init__(self):
+        self.resto = bytearray()
+        self.malos = 0
+        self.perdidos = 0
+        self.seq = None
+
+    def meter(self, datos):
+        self.resto += datos
+        while True:
+            fin = self.resto.find(0)
+            if fin < 0:
+                return
+            bloque = bytes(self.resto[:fin])
+            del self.resto[:fin + 1]
+            if not bloque:
+                continue
+            r = registro(bloque)
+            if r is None:
+                self.malos += 1
+                continue
+            faltan = 0 if self.seq is None else (r[0] - self.seq - 1) & 0xFF
+            self.perdidos += faltan
+            self.seq = r[0]
+            yield r, faltan
+
+
+def nombre(color):
+    if color == DESCONOCIDO:
+        return 'DESCONOCIDO'
+    return COLORES[color] if color < len(COLORES) else str(color)
+
+
+def abrir(a):
+    """Archivo con una captura cruda o puerto serie."""
+    if os.path.isfile(a.entrada):
+        return open(a.entrada, 'rb'), False
+    try:
+        import serial
+    except ImportError:
+        raise SystemExit('falta pyserial (pip install pyserial)')
+    if a.bin:
+        # El comando se manda a la velocidad de texto; el micro contesta y cambia
+        with serial.Serial(a.entrada, BAUD_TEXTO, timeout=0.5) as p:
+            p.write(b'bin\n')
+            p.flush()
+            time.sleep(0.1)
+    return serial.Serial(a.entrada, a.baud, timeout=0.2), True
+
+
+def main(argv):
+    ap = argparse.ArgumentParser(description='Graba a CSV los registros binarios del selector de colores.')
+    ap.add_argument('entrada', help='puerto serie o archivo con una captura cruda')
+    ap.add_argument('-o', '--salida', help='CSV a generar (por defecto, la salida estandar)')
+    ap.add_argument('-b', '--baud', type=int, default=250000, help='BAUD_BIN de main.c')
+    ap.add_argument('--bin', action='store_true', help='mandar antes "bin" a %d baud' % BAUD_TEXTO)
+    ap.add_argument('-n', '--cantidad', type=int, default=0, help='parar despues de n registros (0 = Ctrl-C)')
+    a = ap.parse_args(argv[1:])
+
+    fuente, puerto = abrir(a)
+    salida = open(a.salida, 'w', newline='') if a.salida else sys.stdout
+    w = csv.writer(salida)
+    w.writerow(['t', 'seq', 'r', 'g', 'b', 'color', 'nombre', 'dr', 'dg', 'db', 'perdidos'])
+
+    lector = Lector()
+    n = 0
+    t0 = time.time()
+    try:
+        while not a.cantidad or n < a.cantidad:
+            datos = fuente.read(256)
+            if not datos:
+                if puerto:
+                    continue
+                break
+            t = round(time.time() - t0, 4) if puerto else ''
+            for (seq, r, g, b, color, dr, dg, db), faltan in lector.meter(datos):
+                w.writerow([t, seq, r, g, b, color, nombre(color), dr, dg, db, faltan])
+                n += 1
+                if a.cantidad and n >= a.cantidad:
+                    break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        fuente.close()
+        if a.salida:
+            salida.close()
+
+    seg = time.time() - t0
+    print('%d registros, %d perdidos, %d con error%s'
+          % (n, lector.perdidos, lector.malos,
+             ', %.1f registros/s' % (n / seg) if puerto and seg > 0 else ''), file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -32,6 +32,8 @@ Funcionalidades detalladas:
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include "../../comun/formato.h"
+#include "../../comun/formato.c"
 
 #ifndef _BV
 #define _BV(bit) (1U << (bit))
@@ -1675,6 +1677,18 @@ uint8_t usart_rx_available(void) {
 	return (uint8_t)((rx_head - rx_tail) & RX_MASK);
 }
 
+// Duracion de un track en ms: encendido + apagado de cada nota
+uint32_t track_ms(const int (*track)[3], uint16_t notes) {
+	uint32_t ms = 0;
+	int values[3];
+
+	for (uint16_t i = 0; i < notes; i++) {
+		read_midi_event(track, i, values);
+		ms += (uint16_t)values[1] + (uint16_t)values[2];
+	}
+	return ms;
+}
+
 
 
 
@@ -1710,6 +1724,12 @@ uint16_t usart_write_str(const char *s) {
 	return n;
 }
 
+// Salida de fmt_printf_P: igual que usart_write_str, si se llena el
+// buffer se pierde el resto
+void fmt_escribir(const char *d, uint8_t n) {
+	while (n-- && usart_write_try((uint8_t)*d++));
+}
+
 // Leer byte del buffer de recepcion
 uint8_t usart_read_try(uint8_t *b) {
 	if (rx_head == rx_tail) return 0;                
@@ -1900,6 +1920,13 @@ void handleButtonChange(uint8_t PORT) {
 
 
 // USART -------------------------------------
+// Informar la cancion elegida: notas y duracion (m:ss)
+void printSong(uint8_t number, uint16_t notes, uint32_t ms) {
+	char t[8];
+	fmt_mmss(t, (uint16_t)fmt_div_pot10(ms, 3));
+	fmt_printf_P(PSTR("Cancion %u: %u notas, %s\r\n"), number, notes, t);
+}
+
 // Manejo de cambio de estados de usart
 void handleUSART(uint8_t character){
 	if (character == '1'){
@@ -1928,6 +1955,9 @@ void handleUSART(uint8_t character){
 		PCICR &= ~((1 << PCIE1) | (1 << PCIE2));
 		stopFrequencyB();
 		
+		printSong(1, sizeof(midiC) / sizeof(midiC[0]),
+		          track_ms(midiC, sizeof(midiC) / sizeof(midiC[0])));
+		
 	} else if (character == '2'){
 		mode = 1;
 		eventAoff = 1;
@@ -1954,6 +1984,12 @@ void handleUSART(uint8_t character){
 		PCICR &= ~((1 << PCIE1) | (1 << PCIE2));
 		stopFrequencyA();
 
+		// Dos tracks a la vez: dura lo que el mas largo
+		uint32_t msA = track_ms(midiA, sizeof(midiA) / sizeof(midiA[0]));
+		uint32_t msB = track_ms(midiB, sizeof(midiB) / sizeof(midiB[0]));
+		printSong(2, sizeof(midiA) / sizeof(midiA[0]) + sizeof(midiB) / sizeof(midiB[0]),
+		          (msA > msB) ? msA : msB);
+
 	} else if (character == 'P'){
 		mode = 0;
 		eventAoff = 0;
@@ -1978,6 +2014,8 @@ void handleUSART(uint8_t character){
 		startDebounceTimer();
 		stopFrequencyA();
 		stopFrequencyB();
+		
+		fmt_printf_P(PSTR("Modo piano\r\n"));
 	}
 }
 
@@ -0,0 +1,228 @@
+/*
+ * formato.c
+ *
+ * Numeros a texto sin divisiones (ver formato.h).
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "formato.h"
+
+
+// 10^9 .. 10: digitos de 32 bits restando
+static const uint32_t fmt_pot10[9] PROGMEM = {
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+	10000UL, 1000UL, 100UL, 10UL
+};
+
+
+// v / 10 = (v * 0xCCCD) >> 19, exacto para todo v de 16 bits: una
+// multiplicacion de 16x16 y corrimientos en lugar de una division
+char *fmt_u16(char *d, uint16_t v) {
+	char t[5];
+	uint8_t n = 0;
+
+	do {
+		uint16_t q = (uint16_t)(((uint32_t)v * 0xCCCD) >> 19);
+		t[n++] = '0' + (uint8_t)(v - q * 10);
+		v = q;
+	} while (v);
+	while (n) *d++ = t[--n];
+	*d = '\0';
+	return d;
+}
+
+char *fmt_i16(char *d, int16_t v) {
+	if (v < 0) {
+		*d++ = '-';
+		return fmt_u16(d, -(uint16_t)v);
+	}
+	return fmt_u16(d, (uint16_t)v);
+}
+
+// Como mucho 9 restas por digito, sin multiplicar
+char *fmt_u32(char *d, uint32_t v) {
+	uint8_t i = 0;
+
+	if (v <= 0xFFFF) return fmt_u16(d, (uint16_t)v);
+	while (v < pgm_read_dword(&fmt_pot10[i])) i++;
+	for (; i < 9; i++) {
+		uint32_t p = pgm_read_dword(&fmt_pot10[i]);
+		char c = '0';
+		while (v >= p) {
+			v -= p;
+			c++;
+		}
+		*d++ = c;
+	}
+	*d++ = '0' + (uint8_t)v;
+	*d = '\0';
+	return d;
+}
+
+char *fmt_i32(char *d, int32_t v) {
+	if (v < 0) {
+		*d++ = '-';
+		return fmt_u32(d, -(uint32_t)v);
+	}
+	return fmt_u32(d, (uint32_t)v);
+}
+
+// Punto fijo sin signo: (1234, 2) -> "12.34", (5, 2) -> "0.05"
+static char *fmt_fijo_u(char *d, uint32_t u, uint8_t dec) {
+	char t[11];
+	uint8_t n = (uint8_t)(fmt_u32(t, u) - t);
+	uint8_t i = 0;
+
+	// Parte entera (un 0 si no hay) y los decimales, con ceros adelante si faltan
+	if (n > dec) {
+		while (i < n - dec) *d++ = t[i++];
+	}
+	else {
+		*d++ = '0';
+	}
+	if (dec) {
+		*d++ = '.';
+		for (uint8_t k = n; k < dec; k++) *d++ = '0';
+		while (i < n) *d++ = t[i++];
+	}
+	*d = '\0';
+	return d;
+}
+
+char *fmt_fijo(char *d, int32_t v, uint8_t dec) {
+	if (v < 0) {
+		*d++ = '-';
+		return fmt_fijo_u(d, -(uint32_t)v, dec);
+	}
+	return fmt_fijo_u(d, (uint32_t)v, dec);
+}
+
+// s / 60 = (s * 0x8889) >> 21, exacto para todo s de 16 bits; los
+// segundos (< 60) se parten en decenas con (x * 205) >> 11
+char *fmt_mmss(char *d, uint16_t s) {
+	uint16_t m = (uint16_t)(((uint32_t)s * 0x8889) >> 21);
+	uint8_t  x = (uint8_t)(s - m * 60);
+	uint8_t  dec = (uint8_t)((x * 205) >> 11);
+
+	d = fmt_u16(d, m);
+	*d++ = ':';
+	*d++ = '0' + dec;
+	*d++ = '0' + (x - dec * 10);
+	*d = '\0';
+	return d;
+}
+
+// Como fmt_u32: resta las potencias de 10 hasta 10^n y arma el cociente
+// con los digitos que quedan a la izquierda
+uint32_t fmt_div_pot10(uint32_t v, uint8_t n) {
+	uint32_t q = 0;
+
+	for (uint8_t i = 0; i <= 9 - n; i++) {
+		uint32_t p = pgm_read_dword(&fmt_pot10[i]);
+		uint8_t c = 0;
+		while (v >= p) {
+			v -= p;
+			c++;
+		}
+		q = (q << 3) + (q << 1) + c;
+	}
+	return q;
+}
+
+// Division con resto de 7 pasos (el resultado entra en 7 bits). Con
+// total de 2^25 o mas los dos se achican para que total << 6 y parte * 100
+// entren en 32 bits, y puede dar uno menos
+uint8_t fmt_porciento(uint32_t parte, uint32_t total) {
+	uint8_t pct = 0;
+
+	if (parte >= total) return 100;
+	while (total >= (1UL << 25)) {
+		total >>= 1;
+		parte >>= 1;
+	}
+	parte *= 100;
+	for (int8_t k = 6; k >= 0; k--) {
+		uint32_t t = total << k;
+		if (parte >= t) {
+			parte -= t;
+			pct += (uint8_t)(1 << k);
+		}
+	}
+	return (pct < 100) ? pct : 99;               // parte < total: nunca es el 100 %
+}
+
+
+uint8_t fmt_printf_P(const char *f, ...) {
+	char l[FMT_LINEA_MAX];
+	char num[14];
+	uint8_t n = 0;
+	char c;
+	va_list ap;
+
+	va_start(ap, f);
+	while ((c = pgm_read_byte(f++)) != '\0') {
+		const char *s = num;
+		uint8_t flash = 0, signo = 0, cero = 0, ancho = 0, dec = 0, largo = 0;
+
+		if (c != '%') {
+			if (n < FMT_LINEA_MAX) l[n++] = c;
+			continue;
+		}
+
+		c = pgm_read_byte(f++);
+		if (c == '+') { signo = 1; c = pgm_read_byte(f++); }
+		if (c == '0') { cero = 1; c = pgm_read_byte(f++); }
+		if (c >= '1' && c <= '9') { ancho = c - '0'; c = pgm_read_byte(f++); }
+		if (c == '.') { dec = pgm_read_byte(f++) - '0'; c = pgm_read_byte(f++); }
+		if (c == 'l') { largo = 1; c = pgm_read_byte(f++); }
+
+		switch (c) {
+			case 'u':
+			case 'd': {
+				uint32_t u;
+				char *p = num;
+
+				if (largo) u = va_arg(ap, uint32_t);
+				else if (c == 'u') u = (uint16_t)va_arg(ap, unsigned int);
+				else u = (uint32_t)(int32_t)(int16_t)va_arg(ap, int);
+				if (c == 'd' && (int32_t)u < 0) {
+					*p++ = '-';
+					u = -u;
+				}
+				else if (signo) {
+					*p++ = '+';
+				}
+				fmt_fijo_u(p, u, dec);                 // con dec = 0 es el entero
+				break;
+			}
+			case 's': s = va_arg(ap, const char *); break;
+			case 'S': s = va_arg(ap, const char *); flash = 1; break;
+			case 'c': num[0] = (char)va_arg(ap, int); num[1] = '\0'; break;
+			case '%': num[0] = '%'; num[1] = '\0'; break;
+			case '\0': f--; num[0] = '\0'; break;       // '%' al final del formato
+			default: num[0] = '?'; num[1] = '\0'; break;
+		}
+
+		// Relleno hasta el ancho; con ceros van despues del signo
+		uint8_t len = flash ? (uint8_t)strlen_P(s) : (uint8_t)strlen(s);
+		if (ancho > len) {
+			uint8_t k = ancho - len;
+			if (cero && (*s == '-' || *s == '+') && !flash) {
+				if (n < FMT_LINEA_MAX) l[n++] = *s++;
+			}
+			while (k--) {
+				if (n < FMT_LINEA_MAX) l[n++] = cero ? '0' : ' ';
+			}
+		}
+		while ((c = flash ? pgm_read_byte(s) : *s) != '\0') {
+			if (n < FMT_LINEA_MAX) l[n++] = c;
+			s++;
+		}
+	}
+	va_end(ap);
+
+	fmt_escribir(l, n);
+	return n;
+}
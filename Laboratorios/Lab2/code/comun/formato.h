@@ -0,0 +1,48 @@
+/*
+ * formato.h
+ *
+ * Numeros a texto sin divisiones, comun a los proyectos del laboratorio
+ * (se incluye el .c desde main.c, como los modulos del plotter).
+ * En el AVR cada '/ 10' o '% 10' es una llamada a __udivmodhi4 (unos 200
+ * ciclos en 16 bits y bastante mas en 32): los de 16 bits dividen por 10
+ * multiplicando por el reciproco y los de 32 restan potencias de 10.
+ *
+ * fmt_printf_P arma una linea con un formato en flash y la manda de una
+ * vez con fmt_escribir, que define cada main.c sobre su buffer de
+ * transmision (asi cada proyecto aplica su politica a la linea entera).
+ *   %u %d        16 bits (unsigned / int)
+ *   %lu %ld      32 bits (uint32_t / int32_t)
+ *   %s %S %c %%  texto en SRAM, texto en flash, caracter
+ * Opciones, en este orden: '+' (signo siempre), '0' (rellenar con ceros),
+ * ancho (1..9) y ".n": punto fijo, el entero va en unidades de 10^-n
+ * ("%.2ld" con 1234 -> "12.34").
+ */
+
+
+#ifndef FORMATO_H_
+#define FORMATO_H_
+
+#include <stdint.h>
+
+#ifndef FMT_LINEA_MAX
+#define FMT_LINEA_MAX  128         // largo maximo de una linea de fmt_printf_P
+#endif
+
+// Escriben el numero y el '\0'; devuelven el final (donde quedo el '\0')
+char *fmt_u16(char *d, uint16_t v);
+char *fmt_i16(char *d, int16_t v);
+char *fmt_u32(char *d, uint32_t v);
+char *fmt_i32(char *d, int32_t v);
+char *fmt_fijo(char *d, int32_t v, uint8_t dec);   // v en unidades de 10^-dec
+char *fmt_mmss(char *d, uint16_t s);               // segundos como "m:ss"
+
+// Cuentas para armar los numeros, tambien sin dividir
+uint32_t fmt_div_pot10(uint32_t v, uint8_t n);     // v / 10^n (n de 1 a 9)
+uint8_t fmt_porciento(uint32_t parte, uint32_t total);   // parte * 100 / total, hasta 100
+
+uint8_t fmt_printf_P(const char *f, ...);          // devuelve el largo de la linea
+
+// Definida en main.c: manda n caracteres por la UART
+void fmt_escribir(const char *d, uint8_t n);
+
+#endif /* FORMATO_H_ */